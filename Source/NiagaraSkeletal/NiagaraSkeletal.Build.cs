@@ -37,17 +37,26 @@ public class NiagaraSkeletal : ModuleRules
 		PrivateDependencyModuleNames.AddRange(
 			new string[]
 			{
+				"AnimationBudgetAllocator",
 				"CoreUObject",
 				"Engine",
+				"Json",
 				"Slate",
 				"SlateCore",
 				"Niagara",
 				"RenderCore",
 				"Projects",
 				"UnrealEd",
+				"MeshDescription",
+				"StaticMeshDescription",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
+
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("DerivedDataCache");
+		}
 		
 		
 		DynamicallyLoadedModuleNames.AddRange(
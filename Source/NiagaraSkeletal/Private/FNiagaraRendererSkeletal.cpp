@@ -1,30 +1,265 @@
 ﻿#include "FNiagaraRendererSkeletal.h"
 #include "NiagaraEmitterInstance.h"
+#include "NiagaraSkeletalAnimInstance.h"
+#include "NiagaraSkeletalBenchmark.h"
+#include "NiagaraSkeletalComponentPoolSubsystem.h"
 #include "NiagaraSkeletalRendererProperties.h"
+#include "NiagaraSkeletalVertexAnimation.h"
 #include "NiagaraSystemInstance.h"
+#include "IAnimationBudgetAllocator.h"
+#include "SkeletalMeshComponentBudgeted.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/Texture2D.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
 
-FNiagaraParticleData::FNiagaraParticleData(const UNiagaraSkeletalRendererProperties* Properties, FNiagaraDataSet& Data, int32 ParticleIndex)
+DECLARE_STATS_GROUP(TEXT("NiagaraSkeletal"), STATGROUP_NiagaraSkeletal, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("PostSystemTick [GT]"), STAT_NiagaraSkeletal_PostSystemTick, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Extract Particles"), STAT_NiagaraSkeletal_Extract, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Reconcile IDs"), STAT_NiagaraSkeletal_Reconcile, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Cull"), STAT_NiagaraSkeletal_Cull, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Prioritize"), STAT_NiagaraSkeletal_Prioritize, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Assign Components"), STAT_NiagaraSkeletal_Assign, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Create Components"), STAT_NiagaraSkeletal_Create, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Compute Updates"), STAT_NiagaraSkeletal_ComputeUpdates, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Apply Updates"), STAT_NiagaraSkeletal_Apply, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Pool Cleanup"), STAT_NiagaraSkeletal_Cleanup, STATGROUP_NiagaraSkeletal);
+DECLARE_CYCLE_STAT(TEXT("Instanced Meshes"), STAT_NiagaraSkeletal_InstancedMeshes, STATGROUP_NiagaraSkeletal);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Components"), STAT_NiagaraSkeletal_LiveComponents, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Components"), STAT_NiagaraSkeletal_PooledComponents, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pool Hits"), STAT_NiagaraSkeletal_PoolHits, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pool Misses"), STAT_NiagaraSkeletal_PoolMisses, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Components Created"), STAT_NiagaraSkeletal_Created, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Components Reconfigured"), STAT_NiagaraSkeletal_Reconfigured, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Components Destroyed"), STAT_NiagaraSkeletal_Destroyed, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Particles Over Limit"), STAT_NiagaraSkeletal_Dropped, STATGROUP_NiagaraSkeletal);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Particles Pending Creation"), STAT_NiagaraSkeletal_Pending, STATGROUP_NiagaraSkeletal);
+DECLARE_MEMORY_STAT(TEXT("Pool Memory"), STAT_NiagaraSkeletal_PoolMemory, STATGROUP_NiagaraSkeletal);
+
+CSV_DEFINE_CATEGORY(NiagaraSkeletal, true);
+
+// Stats are compiled out of Test and Shipping, trace events and CSV timings are what's left to see the phases in captures from those builds
+#if STATS
+#define NIAGARA_SKELETAL_SCOPE(Phase) SCOPE_CYCLE_COUNTER(STAT_NiagaraSkeletal_##Phase); CSV_SCOPED_TIMING_STAT(NiagaraSkeletal, Phase); \
+	NiagaraSkeletalBenchmark::FPhaseScope ANONYMOUS_VARIABLE(BenchmarkScope)(NiagaraSkeletalBenchmark::EPhase::Phase)
+#else
+#define NIAGARA_SKELETAL_SCOPE(Phase) TRACE_CPUPROFILER_EVENT_SCOPE(NiagaraSkeletal_##Phase); CSV_SCOPED_TIMING_STAT(NiagaraSkeletal, Phase); \
+	NiagaraSkeletalBenchmark::FPhaseScope ANONYMOUS_VARIABLE(BenchmarkScope)(NiagaraSkeletalBenchmark::EPhase::Phase)
+#endif
+
+static int32 GNiagaraSkeletalParallelForBatchSize = 64;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalParallelForBatchSize(
+	TEXT("fx.Niagara.Skeletal.ParallelForBatchSize"),
+	GNiagaraSkeletalParallelForBatchSize,
+	TEXT("Minimum number of components each worker computes transforms for, below this the skeletal renderer stays on the calling thread."),
+	ECVF_Default
+);
+
+static float GNiagaraSkeletalComponentCreationBudgetMS = 0.0f;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalComponentCreationBudgetMS(
+	TEXT("fx.Niagara.Skeletal.ComponentCreationBudgetMS"),
+	GNiagaraSkeletalComponentCreationBudgetMS,
+	TEXT("Milliseconds each skeletal renderer may spend creating components per tick, unless the renderer sets its own budget. Particles over budget wait for later ticks. 0 means unlimited."),
+	ECVF_Default
+);
+
+namespace NiagaraSkeletalRendererLocal
 {
-	
-	FNiagaraDataSetReaderInt32<FNiagaraBool> EnabledReader = Properties->EnabledAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderFloat<FNiagaraPosition>  PositionAccessor = Properties->PositionAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderFloat<FVector3f> RotateAccessor = Properties->RotateAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderFloat<FVector3f> ScaleAccessor = Properties->ScaleAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderFloat<float> SkeletalAnimTimeAccessor = Properties->AnimTimeAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderInt32<int>  VisTagAccessor = Properties->VisTagAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderInt32<int> AnimIndexAccessor = Properties->AnimIndexAccessor.GetReader(Data);
-	const FNiagaraDataSetReaderInt32<int32> UniqueIDReaderAccessor = Properties->UniqueIDAccessor.GetReader(Data);
-	
+	// Unbound attributes are filled in a flat loop over the destination so the compiler can vectorize the store
+	template<typename TValue>
+	void FillAttribute(TArray<TValue>& Dest, int32 NumInstances, const TValue& DefaultValue)
+	{
+		TValue* RESTRICT DestData = Dest.GetData();
+		for (int32 ParticleIndex = 0; ParticleIndex < NumInstances; ++ParticleIndex)
+		{
+			DestData[ParticleIndex] = DefaultValue;
+		}
+	}
 
-	Enabled = EnabledReader.GetSafe(ParticleIndex,true);
-	Position = PositionAccessor.GetSafe(ParticleIndex,FNiagaraPosition(ForceInit));
-	Rotate = RotateAccessor.GetSafe(ParticleIndex,FVector3f::Zero());
-	Scale = ScaleAccessor.GetSafe(ParticleIndex,FVector3f::One());
-	SkeletalAnimTime = SkeletalAnimTimeAccessor.GetSafe(ParticleIndex,0.0f);
-	VisTag = VisTagAccessor.GetSafe(ParticleIndex,0);
-	AnimIndex = AnimIndexAccessor.GetSafe(ParticleIndex,0);
-	UniqueID = UniqueIDReaderAccessor.GetSafe(ParticleIndex,-1);
-	
+	template<typename TReader, typename TValue>
+	void ExtractAttribute(const TReader& Reader, TArray<TValue>& Dest, int32 NumInstances, const TValue& DefaultValue)
+	{
+		Dest.SetNumUninitialized(NumInstances, false);
+		if (!Reader.IsValid())
+		{
+			FillAttribute(Dest, NumInstances, DefaultValue);
+			return;
+		}
+
+		TValue* RESTRICT DestData = Dest.GetData();
+		for (int32 ParticleIndex = 0; ParticleIndex < NumInstances; ++ParticleIndex)
+		{
+			DestData[ParticleIndex] = TValue(Reader.Get(ParticleIndex));
+		}
+	}
+
+	// Quickselect, reorders Items so the K highest scores come first in no particular order. Average O(n), unlike sorting everything
+	template<typename TItem>
+	void SelectHighestScores(TArrayView<TItem> Items, int32 K)
+	{
+		int32 Left = 0;
+		int32 Right = Items.Num() - 1;
+		const int32 Nth = K - 1;
+		while (Left < Right)
+		{
+			// median of three keeps buffers that are already ordered by score from going quadratic
+			const float A = Items[Left].Score;
+			const float B = Items[Left + (Right - Left) / 2].Score;
+			const float C = Items[Right].Score;
+			const float Pivot = FMath::Max(FMath::Min(A, B), FMath::Min(FMath::Max(A, B), C));
+
+			int32 I = Left;
+			int32 J = Right;
+			while (I <= J)
+			{
+				while (Items[I].Score > Pivot) { ++I; }
+				while (Items[J].Score < Pivot) { --J; }
+				if (I <= J)
+				{
+					Swap(Items[I], Items[J]);
+					++I;
+					--J;
+				}
+			}
+
+			// [Left, J] scores >= Pivot, [I, Right] scores <= Pivot, anything in between equals it
+			if (Nth <= J)
+			{
+				Right = J;
+			}
+			else if (Nth >= I)
+			{
+				Left = I;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	// Wraps an anim time into a looping animation, so it compares with what a playing component reports
+	float WrapAnimTime(float AnimTime, float AnimLength)
+	{
+		if (AnimLength <= UE_SMALL_NUMBER)
+		{
+			return AnimTime;
+		}
+		const float Wrapped = FMath::Fmod(AnimTime, AnimLength);
+		return Wrapped < 0.0f ? Wrapped + AnimLength : Wrapped;
+	}
+
+	// Shortest signed step between two wrapped anim times, going across the loop point when that is closer
+	float GetAnimTimeDelta(float FromTime, float ToTime, float AnimLength)
+	{
+		float Delta = ToTime - FromTime;
+		if (AnimLength > UE_SMALL_NUMBER && FMath::Abs(Delta) > AnimLength * 0.5f)
+		{
+			Delta -= FMath::Sign(Delta) * AnimLength;
+		}
+		return Delta;
+	}
+}
+
+FNiagaraSkeletalParticleReaders::FNiagaraSkeletalParticleReaders(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraDataSet& Data)
+	: Enabled(Properties->EnabledAccessor.GetReader(Data))
+	, Position(Properties->PositionAccessor.GetReader(Data))
+	, Rotate(Properties->RotateAccessor.GetReader(Data))
+	, Scale(Properties->ScaleAccessor.GetReader(Data))
+	, SkeletalAnimTime(Properties->AnimTimeAccessor.GetReader(Data))
+	, VisTag(Properties->VisTagAccessor.GetReader(Data))
+	, AnimIndex(Properties->AnimIndexAccessor.GetReader(Data))
+	, UniqueID(Properties->UniqueIDAccessor.GetReader(Data))
+	, Priority(Properties->PriorityAccessor.GetReader(Data))
+	, AnimBlendParameters(Properties->AnimBlendParametersAccessor.GetReader(Data))
+	, DataBuffer(Data.GetCurrentData())
+	, CustomDataLayouts(Properties->CustomDataLayouts)
+	, NumCustomDataFloats(Properties->NumCustomDataFloats)
+{
+}
+
+SIZE_T FNiagaraSkeletalParticleBatch::GetAllocatedSize() const
+{
+	return Position.GetAllocatedSize() + Rotate.GetAllocatedSize() + Scale.GetAllocatedSize() + SkeletalAnimTime.GetAllocatedSize() + VisTag.GetAllocatedSize()
+		+ AnimIndex.GetAllocatedSize() + UniqueID.GetAllocatedSize() + Enabled.GetAllocatedSize() + Priority.GetAllocatedSize() + AnimBlendParameters.GetAllocatedSize()
+		+ CustomData.GetAllocatedSize();
+}
+
+FNiagaraSkeletalSimulationSpace::FNiagaraSkeletalSimulationSpace(const FNiagaraEmitterInstance* Emitter)
+	: bLocalSpace(Emitter->GetCachedEmitterData()->bLocalSpace)
+{
+	const FNiagaraSystemInstance* SystemInstance = Emitter->GetParentSystemInstance();
+	LwcConverter = SystemInstance->GetLWCConverter(bLocalSpace);
+	LocalToWorld = bLocalSpace ? SystemInstance->GetWorldTransform() : FTransform::Identity;
+}
+
+float FNiagaraSkeletalPlayRateTracker::GetPlayRate(float ParticleAnimTime, float AnimLength, float DeltaSeconds) const
+{
+	return bHasLastTime && DeltaSeconds > UE_SMALL_NUMBER ? NiagaraSkeletalRendererLocal::GetAnimTimeDelta(LastParticleAnimTime, ParticleAnimTime, AnimLength) / DeltaSeconds : 1.0f;
+}
+
+void FNiagaraSkeletalPlayRateTracker::Record(float ParticleAnimTime)
+{
+	LastParticleAnimTime = ParticleAnimTime;
+	bHasLastTime = true;
+}
+
+void FNiagaraSkeletalPlayRateTracker::Reset()
+{
+	bHasLastTime = false;
+}
+
+void FNiagaraSkeletalParticleBatch::Extract(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraDataSet& Data, int32 NumInstances, bool bParallel)
+{
+	// Readers are built once for the whole buffer instead of once per particle
+	Extract(FNiagaraSkeletalParticleReaders(Properties, Data), NumInstances, bParallel);
+}
+
+void FNiagaraSkeletalParticleBatch::Extract(const FNiagaraSkeletalParticleReaders& Readers, int32 NumInstances, bool bParallel)
+{
+	using namespace NiagaraSkeletalRendererLocal;
+
+	NumParticles = NumInstances;
+	// every column is written by a single worker, the last one holds all of the custom data
+	const int32 NumColumns = 11;
+	ParallelFor(TEXT("NiagaraSkeletal.ExtractParticles"), NumColumns, 1, [this, &Readers, NumInstances](int32 Column)
+	{
+		switch (Column)
+		{
+		case 0: ExtractAttribute(Readers.Enabled, Enabled, NumInstances, true); break;
+		case 1: ExtractAttribute(Readers.Position, Position, NumInstances, FNiagaraPosition(ForceInit)); break;
+		case 2: ExtractAttribute(Readers.Rotate, Rotate, NumInstances, FVector3f::ZeroVector); break;
+		case 3: ExtractAttribute(Readers.Scale, Scale, NumInstances, FVector3f::OneVector); break;
+		case 4: ExtractAttribute(Readers.SkeletalAnimTime, SkeletalAnimTime, NumInstances, 0.0f); break;
+		case 5: ExtractAttribute(Readers.VisTag, VisTag, NumInstances, 0); break;
+		case 6: ExtractAttribute(Readers.AnimIndex, AnimIndex, NumInstances, 0); break;
+		case 7: ExtractAttribute(Readers.UniqueID, UniqueID, NumInstances, -1); break;
+		case 8: ExtractAttribute(Readers.Priority, Priority, NumInstances, 1.0f); break;
+		case 9: ExtractAttribute(Readers.AnimBlendParameters, AnimBlendParameters, NumInstances, FVector2f::ZeroVector); break;
+		default:
+			CustomData.SetNumUninitialized(NumInstances * Readers.NumCustomDataFloats, false);
+			for (const FNiagaraSkeletalCustomDataLayout& Layout : Readers.CustomDataLayouts)
+			{
+				for (int32 Component = 0; Component < Layout.NumFloats; ++Component)
+				{
+					const float* RESTRICT SrcData = reinterpret_cast<const float*>(Readers.DataBuffer->GetComponentPtrFloat(Layout.FloatComponentStart + Component));
+					float* RESTRICT DestData = CustomData.GetData() + Layout.PackedOffset + Component;
+					for (int32 ParticleIndex = 0; ParticleIndex < NumInstances; ++ParticleIndex)
+					{
+						DestData[ParticleIndex * Readers.NumCustomDataFloats] = SrcData[ParticleIndex];
+					}
+				}
+			}
+			break;
+		}
+	}, bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
 }
 
 FNiagaraRendererSkeletal::FNiagaraRendererSkeletal(ERHIFeatureLevel::Type FeatureLevel, const UNiagaraRendererProperties* InProps, const FNiagaraEmitterInstance* Emitter)
@@ -32,29 +267,91 @@ FNiagaraRendererSkeletal::FNiagaraRendererSkeletal(ERHIFeatureLevel::Type Featur
 {
 	const UNiagaraSkeletalRendererProperties* Properties = CastChecked<const UNiagaraSkeletalRendererProperties>(InProps);
 	ComponentPool.Reserve(Properties->ComponentCountLimit);
-	
+	bUseWorldComponentPool = Properties->bUseWorldComponentPool;
+
+	for (const FNiagaraSkeletalReference& Entry : Properties->SkeletalMeshes)
+	{
+		bHasBoundMeshes |= Entry.SkeletalMeshUserParameterBinding.Parameter.IsValid();
+	}
+	ResolvedMeshes.SetNumZeroed(Properties->SkeletalMeshes.Num());
+	for (int32 MeshIndex = 0; MeshIndex < Properties->SkeletalMeshes.Num(); ++MeshIndex)
+	{
+		ResolvedMeshes[MeshIndex] = Properties->ResolveSkeletalMesh(Emitter, MeshIndex);
+	}
+
+	// mirrors how GetUsedMaterials lays out BaseMaterials_GT
+	if (Properties->RenderMode == ENiagaraSkeletalRenderMode::Components)
+	{
+		AnimationLengths.SetNumZeroed(Properties->Animations.Num());
+		for (int32 AnimIndex = 0; AnimIndex < Properties->Animations.Num(); ++AnimIndex)
+		{
+			AnimationLengths[AnimIndex] = Properties->Animations[AnimIndex] ? Properties->Animations[AnimIndex]->GetPlayLength() : 0.0f;
+		}
+
+		int32 FirstMaterial = 0;
+		MeshMaterials.SetNum(Properties->SkeletalMeshes.Num());
+		for (int32 MeshIndex = 0; MeshIndex < Properties->SkeletalMeshes.Num(); ++MeshIndex)
+		{
+			const FNiagaraSkeletalReference& Entry = Properties->SkeletalMeshes[MeshIndex];
+			USkeletalMesh* SkeletalMesh = ResolvedMeshes[MeshIndex];
+			FMeshMaterials& Materials = MeshMaterials[MeshIndex];
+			Materials.FirstMaterial = FirstMaterial;
+			Materials.NumMaterials = SkeletalMesh ? FMath::Max(SkeletalMesh->GetMaterials().Num(), Entry.OverrideMaterials.Num()) : 0;
+			Materials.LayoutMesh = SkeletalMesh;
+			FirstMaterial += Materials.NumMaterials;
+
+			Materials.BoundOverrides.SetNum(Entry.OverrideMaterials.Num());
+			for (int32 SlotIndex = 0; SlotIndex < Entry.OverrideMaterials.Num(); ++SlotIndex)
+			{
+				if (Entry.OverrideMaterials[SlotIndex].UserParamBinding.Parameter.IsValid())
+				{
+					Materials.BoundOverrides[SlotIndex] = Cast<UMaterialInterface>(Emitter->FindBinding(Entry.OverrideMaterials[SlotIndex].UserParamBinding.Parameter));
+				}
+			}
+		}
+
+		// Renderers are constructed by the Niagara component's scene proxy, i.e. when it registers or activates, which is before the system's
+		// first tick, so the pool is filled right here in the constructor. A proxy built off the game thread (parallel render state
+		// creation) can't spawn components, those renderers prewarm at the start of their first PostSystemTick_GameThread instead
+		FNiagaraSystemInstance* SystemInstance = Emitter->GetParentSystemInstance();
+		USceneComponent* AttachComponent = SystemInstance ? SystemInstance->GetAttachComponent() : nullptr;
+		if (Properties->PrewarmComponentCount > 0 && IsInGameThread() && AttachComponent && AttachComponent->GetWorld())
+		{
+			PrewarmComponentPool(Properties, Emitter, AttachComponent);
+		}
+	}
 }
 
 FNiagaraRendererSkeletal::~FNiagaraRendererSkeletal()
 {
-	check(ComponentPool.Num() == 0);
+	DEC_MEMORY_STAT_BY(STAT_NiagaraSkeletal_PoolMemory, ReportedPoolMemory);
+	check(ComponentPool.Num() == 0 && InstancedMeshes.Num() == 0);
 }
 
 void FNiagaraRendererSkeletal::DestroyRenderState_Concurrent()
 {
 	AsyncTask(
 			ENamedThreads::GameThread,
-			[Pool_GT=MoveTemp(ComponentPool), Owner_GT=MoveTemp(SpawnedOwner)]()
+			[Pool_GT=MoveTemp(ComponentPool), InstancedMeshes_GT=MoveTemp(InstancedMeshes), Owner_GT=MoveTemp(SpawnedOwner), bUseWorldPool_GT=bUseWorldComponentPool]()
 			{
-				// we do not reset ParticlesWithComponents here because it's possible the render state is destroyed without destroying the renderer. In this case we want to know which particles
-				// had spawned some components previously
+				FNiagaraSkeletalTickCounters ReleaseCounters;
 				for (auto& PoolEntry : Pool_GT)
 				{
 					if (USkeletalMeshComponent* Component = PoolEntry.Component.Get())
+					{
+						ReleaseCounters.NumDestroyed += ReleaseComponent(Component, bUseWorldPool_GT) ? 1 : 0;
+					}
+				}
+
+				for (auto& InstancedMesh : InstancedMeshes_GT)
+				{
+					if (UInstancedStaticMeshComponent* Component = InstancedMesh.Component.Get())
 					{
 						Component->DestroyComponent();
+						++ReleaseCounters.NumDestroyed;
 					}
 				}
+				PublishReleaseCounters(ReleaseCounters);
 
 				if (AActor* OwnerActor = Owner_GT.Get())
 				{
@@ -63,10 +360,13 @@ void FNiagaraRendererSkeletal::DestroyRenderState_Concurrent()
 			}
 		);
 	SpawnedOwner.Reset();
+	ComponentPool.Reset();
+	bPoolPrewarmed = false;
 }
 
 void FNiagaraRendererSkeletal::PostSystemTick_GameThread(const UNiagaraRendererProperties* InProperties, const FNiagaraEmitterInstance* Emitter)
 {
+	NIAGARA_SKELETAL_SCOPE(PostSystemTick);
 	FNiagaraSystemInstance* SystemInstance = Emitter->GetParentSystemInstance();
 
 	//Bail if we don't have the required attributes to render this emitter.
@@ -95,247 +395,587 @@ void FNiagaraRendererSkeletal::PostSystemTick_GameThread(const UNiagaraRendererP
 	FNiagaraDataBuffer& ParticleData = Data.GetCurrentDataChecked();
 	
 	const bool bIsRendererEnabled = IsRendererEnabled(InProperties, Emitter);
-	
-	TMap<int32, int32> ParticlesWithComponents;
-	TArray<int32> FreeList;
-	if (Properties->bAssignComponentsOnParticleID && ComponentPool.Num() > 0)
+	const int64 ContainerSizeAtStart = NiagaraSkeletalBenchmark::IsEnabled() ? GetContainerAllocatedSize() : 0;
+	const double CurrentTime = AttachComponent->GetWorld()->GetTimeSeconds();
+
 	{
-		FreeList.Reserve(ComponentPool.Num());
+		NIAGARA_SKELETAL_SCOPE(Extract);
+		ParticleBatch.Extract(Properties, Data, ParticleData.GetNumInstances(), Properties->bExtractParticlesInParallel);
+	}
+	const int32 NumParticles = ParticleBatch.Num();
 
-		// Determine the slots that were assigned to particles last frame
-		TMap<int32, int32> UsedSlots;
-		UsedSlots.Reserve(ComponentPool.Num());
-		for (int32 EntryIndex = 0; EntryIndex < ComponentPool.Num(); ++EntryIndex)
+	if (Properties->RenderMode != ENiagaraSkeletalRenderMode::Components)
+	{
+		const int32 NumLiveComponents = TickInstancedMeshes(Properties, Emitter, AttachComponent, bIsRendererEnabled);
+		if (NiagaraSkeletalBenchmark::IsEnabled())
 		{
-			FComponentPoolEntry& Entry = ComponentPool[EntryIndex];
-			if (Entry.LastAssignedToParticleID >= 0)
-			{
-				UsedSlots.Emplace(Entry.LastAssignedToParticleID, EntryIndex);
-			}
-			else
-			{
-				FreeList.Add(EntryIndex);
-			}
+			NiagaraSkeletalBenchmark::AddTick(TickCounters, NumParticles, NumLiveComponents, InstancedMeshes.Num(), GetContainerAllocatedSize() - ContainerSizeAtStart);
 		}
+		TickCounters = FNiagaraSkeletalTickCounters();
+		return;
+	}
 	
-		// Ensure the final list only contains particles that are alive and enabled
-		ParticlesWithComponents.Reserve(UsedSlots.Num());
-		for (uint32 ParticleIndex = 0; ParticleIndex < ParticleData.GetNumInstances(); ParticleIndex++)
+	if (Properties->bAssignComponentsOnParticleID && ComponentPool.Num() > 0)
+	{
+		NIAGARA_SKELETAL_SCOPE(Reconcile);
+		// Ensure only particles that are alive and enabled keep the slots they were assigned last frame, the components of the
+		// rest get deactivated before re-use
+		ComponentPool.Reconcile(MakeArrayView(ParticleBatch.UniqueID.GetData(), NumParticles), MakeArrayView(ParticleBatch.Enabled.GetData(), NumParticles), [this](int32 PoolIndex)
 		{
-			FNiagaraParticleData PerParticleData = FNiagaraParticleData(Properties,Data,ParticleIndex);
-			int32 ParticleID = PerParticleData.UniqueID;
-			int32 PoolIndex;
-			
-			if (UsedSlots.RemoveAndCopyValue(ParticleID, PoolIndex))
-			{
-				if (PerParticleData.Enabled)
-				{
-					ParticlesWithComponents.Emplace(ParticleID, PoolIndex);
-				}
-				else
-				{
-					// Particle has disabled components since last tick, ensure the component for this entry gets deactivated before re-use
-					USceneComponent* Component = ComponentPool[PoolIndex].Component.Get();
-					if (Component && Component->IsActive())
-					{
-						Component->Deactivate();
-						Component->SetVisibility(false, true);
-					}
-					FreeList.Add(PoolIndex);
-					ComponentPool[PoolIndex].LastAssignedToParticleID = -1;
-				}
-			}
-		}
+			DeactivatePoolEntry(PoolIndex);
+		});
+	}
 
-		// Any remaining in the used slots are now free to be reclaimed, due to their particles either dying or having their component disabled
-		for (TPair<int32, int32> UsedSlot : UsedSlots)
-		{
-			// Particle has died since last tick, ensure the component for this entry gets deactivated before re-use
-			USceneComponent* Component = ComponentPool[UsedSlot.Value].Component.Get();
-			if (Component && Component->IsActive())
-			{
-				Component->Deactivate();
-				Component->SetVisibility(false, true);
-			}
-			FreeList.Add(UsedSlot.Value);
-			ComponentPool[UsedSlot.Value].LastAssignedToParticleID = -1;
-		}
+	if (!bPoolPrewarmed)
+	{
+		PrewarmComponentPool(Properties, Emitter, AttachComponent);
+	}
+
+	if (bHasBoundMeshes)
+	{
+		ResolveSkeletalMeshes(Properties, Emitter);
+	}
+	UpdateMeshMaterials(Properties, Emitter);
+
+	// Views and the conversion to world space are shared by the priority selection and the parallel update pass
+	const FNiagaraSkeletalSimulationSpace SimulationSpace(Emitter);
+	ViewLocations.Reset();
+	if (Properties->bPrioritizeParticles || Properties->AnimationLODs.Num() > 0 || Properties->bUseAnimationBudgetAllocator)
+	{
+		ViewLocations.Append(AttachComponent->GetWorld()->ViewLocationsRenderedLastFrame);
 	}
 
 	const int32 MaxComponents = Properties->ComponentCountLimit;
 	int32 ComponentCount = 0;
-	
-	for(uint32 ParticleIndex = 0;ParticleIndex<ParticleData.GetNumInstances();ParticleIndex++)
+	ComponentUpdates.Reset();
+
+	const bool bCullParticles = bIsRendererEnabled && Properties->bCullOffscreenParticles && ComputeParticleVisibility(Properties, SimulationSpace, AttachComponent->GetWorld());
+	const bool bUseSelectedParticles = bIsRendererEnabled && Properties->bPrioritizeParticles && SelectPriorityParticles(Properties, SimulationSpace, bCullParticles);
+	const int32 NumCandidates = bUseSelectedParticles ? SelectedParticles.Num() : NumParticles;
+
+	// Creating a component is by far the most expensive thing we do, so bursts are spread over several ticks
+	const float CreationBudgetMS = Properties->ComponentCreationBudgetMS > 0.0f ? Properties->ComponentCreationBudgetMS : GNiagaraSkeletalComponentCreationBudgetMS;
+	const double CreationDeadline = CreationBudgetMS > 0.0f ? FPlatformTime::Seconds() + CreationBudgetMS * 0.001 : 0.0;
+	// Creating or reconfiguring a component has its own phase, so the Assign scope is closed around it rather than counting it twice
+	struct FPendingCreation
 	{
-		FNiagaraParticleData PerParticleData = FNiagaraParticleData(Properties,Data,ParticleIndex);
-		if (!bIsRendererEnabled || !PerParticleData.Enabled)
-		{
-			// Skip particles that don't want a component
-			continue;
-		}
-		
+		USkeletalMeshComponent* Component = nullptr;
+		USkeletalMesh* SkeletalMesh = nullptr;
+		int32 ParticleIndex = INDEX_NONE;
 		int32 ParticleID = -1;
 		int32 PoolIndex = -1;
-		if (Properties->bAssignComponentsOnParticleID)
-		{
-			// Get the particle ID and see if we have any components already assigned to the particle
-			ParticleID = PerParticleData.UniqueID;
-			ParticlesWithComponents.RemoveAndCopyValue(ParticleID, PoolIndex);
-		}
+		int32 AnimIndex = 0;
+		int32 PoolKey = 0;
+		bool bReconfigure = false;
+	};
+	// Returns whether the pool is now full
+	auto FinishAssignment = [&](USkeletalMeshComponent* SkeletalMeshComponent, int32 ParticleIndex, int32 PoolIndex, int32 ParticleID)
+	{
+		FComponentUpdate& Update = ComponentUpdates.AddDefaulted_GetRef();
+		Update.Component = SkeletalMeshComponent;
+		Update.ParticleIndex = ParticleIndex;
+		Update.PoolIndex = PoolIndex;
 
-		if (PoolIndex == -1 && ComponentCount + ParticlesWithComponents.Num() >= MaxComponents)
+		if (Properties->bAssignComponentsOnParticleID)
 		{
-			// The pool is full and there aren't any unused slots to claim
-			continue;
+			ComponentPool.Assign(PoolIndex, ParticleID);
 		}
+		++ComponentCount;
+		return ComponentCount >= MaxComponents;
+	};
 
-		// Acquire a component for this particle
-		USkeletalMeshComponent* SkeletalMeshComponent = nullptr;
-		if (PoolIndex == -1)
+	// candidates past the one that filled the pool are never looked at, they still count as dropped
+	int32 CandidateIndex = 0;
+	bool bPoolFull = false;
+	while (CandidateIndex < NumCandidates && !bPoolFull)
+	{
+		FPendingCreation PendingCreation;
 		{
-			// Start by trying to pull from the pool
-			if (!Properties->bAssignComponentsOnParticleID)
+			NIAGARA_SKELETAL_SCOPE(Assign);
+			for(;CandidateIndex<NumCandidates && !bPoolFull;CandidateIndex++)
 			{
-				// We can just take the next slot
-				PoolIndex = ComponentCount < ComponentPool.Num() ? ComponentCount : -1;
-			}
-			else if (FreeList.Num())
-			{
-				PoolIndex = FreeList.Pop(false);
+				const int32 ParticleIndex = bUseSelectedParticles ? SelectedParticles[CandidateIndex] : CandidateIndex;
+				const bool bParticleEnabled = ParticleBatch.Enabled[ParticleIndex];
+				const int32 VisTag = ParticleBatch.VisTag[ParticleIndex];
+				if (!bIsRendererEnabled || !bParticleEnabled)
+				{
+					// Skip particles that don't want a component
+					continue;
+				}
+		
+				int32 ParticleID = -1;
+				int32 PoolIndex = -1;
+				if (Properties->bAssignComponentsOnParticleID)
+				{
+					// Get the particle ID and see if we have any components already assigned to the particle
+					ParticleID = ParticleBatch.UniqueID[ParticleIndex];
+					PoolIndex = ComponentPool.FindSlot(ParticleID);
+				}
+
+				if (bCullParticles && !ParticleVisible[ParticleIndex])
+				{
+					// Off screen, a particle that already has a component holds on to it for a while in case it comes back
+					if (PoolIndex != -1)
+					{
+						SuspendCulledPoolEntry(Properties, PoolIndex, CurrentTime);
+					}
+					continue;
+				}
+
+				// Slots held by particles we haven't reached yet this tick are reserved for them
+				const int32 NumReservedComponents = Properties->bAssignComponentsOnParticleID ? ComponentPool.NumAssigned() : ComponentCount;
+				if (PoolIndex == -1 && NumReservedComponents >= MaxComponents)
+				{
+					// The pool is full and there aren't any unused slots to claim
+					++TickCounters.NumDropped;
+					continue;
+				}
+
+				// Checked before a slot is claimed so a bad tag can't leak it off the free list. Only this particle goes without, one that
+				// held a component for a tag that was valid before gives it back
+				USkeletalMesh* SkeletalMesh = GetResolvedMesh(VisTag);
+				if(!SkeletalMesh)
+				{
+					if (PoolIndex != -1)
+					{
+						DeactivatePoolEntry(PoolIndex);
+						ComponentPool.Release(PoolIndex);
+					}
+					continue;
+				}
+				const int32 AnimIndex = ClampAnimIndex(Properties, ParticleBatch.AnimIndex[ParticleIndex]);
+				const int32 PoolKey = GetPoolKey(Properties, VisTag, AnimIndex);
+
+				// Acquire a component for this particle
+				USkeletalMeshComponent* SkeletalMeshComponent = nullptr;
+				const bool bNeedsComponent = PoolIndex == -1;
+				if (PoolIndex == -1)
+				{
+					// Start by trying to pull from the pool
+					if (!Properties->bAssignComponentsOnParticleID)
+					{
+						// We can just take the next slot
+						PoolIndex = ComponentCount < ComponentPool.Num() ? ComponentCount : -1;
+					}
+					else
+					{
+						// Prefer a component already set up for this mesh and animation. Failing that a new one, as long as the pool may grow,
+						// since a component taken from another sub-pool has to be reconfigured and will likely be wanted back
+						PoolIndex = ComponentPool.AcquireFree(PoolKey, MaxComponents);
+					}
+				}
+
+				if (PoolIndex >= 0)
+				{
+					SkeletalMeshComponent = ComponentPool[PoolIndex].Component.Get();
+				}
+
+				const bool bCreateNewComponent = !SkeletalMeshComponent || SkeletalMeshComponent->HasAnyFlags(RF_BeginDestroyed | RF_FinishDestroyed);
+				// Reconfiguring reinitializes the bones, anim instance and render state, close to what creating a component costs, so it shares the budget
+				const bool bReconfigureComponent = !bCreateNewComponent && !IsComponentConfigured(Properties, SkeletalMeshComponent, SkeletalMesh, AnimIndex);
+		
+				if (bCreateNewComponent || bReconfigureComponent)
+				{
+					// Always allow one creation per tick so pending particles are guaranteed to make progress
+					if (TickCounters.NumCreated + TickCounters.NumReconfigured > 0 && CreationDeadline > 0.0 && FPlatformTime::Seconds() > CreationDeadline)
+					{
+						// Over budget, the particle stays pending and tries again next tick. One that already holds its slot keeps it, showing what it showed last
+						if (Properties->bAssignComponentsOnParticleID && PoolIndex >= 0)
+						{
+							ComponentPool.ReturnUnused(PoolIndex);
+						}
+						++TickCounters.NumPending;
+						continue;
+					}
+					++TickCounters.NumPoolMisses;
+
+					PendingCreation.Component = SkeletalMeshComponent;
+					PendingCreation.SkeletalMesh = SkeletalMesh;
+					PendingCreation.ParticleIndex = ParticleIndex;
+					PendingCreation.ParticleID = ParticleID;
+					PendingCreation.PoolIndex = PoolIndex;
+					PendingCreation.AnimIndex = AnimIndex;
+					PendingCreation.PoolKey = PoolKey;
+					PendingCreation.bReconfigure = bReconfigureComponent;
+					++CandidateIndex;
+					break;
+				}
+				else if (bNeedsComponent)
+				{
+					++TickCounters.NumPoolHits;
+				}
+
+				bPoolFull = FinishAssignment(SkeletalMeshComponent, ParticleIndex, PoolIndex, ParticleID);
 			}
 		}
 
-		if (PoolIndex >= 0)
+		if (PendingCreation.ParticleIndex == INDEX_NONE)
 		{
-			SkeletalMeshComponent = ComponentPool[PoolIndex].Component.Get();
+			continue;
 		}
 
-		bool bCreateNewComponent = !SkeletalMeshComponent || SkeletalMeshComponent->HasAnyFlags(RF_BeginDestroyed | RF_FinishDestroyed);
-		
-		
-		if(!Properties->SkeletalMeshes.IsValidIndex(PerParticleData.VisTag)||!Properties->SkeletalMeshes[PerParticleData.VisTag].SkeletalMesh)
+		int32 PoolIndex = PendingCreation.PoolIndex;
+		USkeletalMeshComponent* SkeletalMeshComponent = PendingCreation.Component;
+		if (PendingCreation.bReconfigure)
 		{
-			return;
+			ReconfigurePoolEntry(Properties, PoolIndex, PendingCreation.SkeletalMesh, PendingCreation.AnimIndex);
+			++TickCounters.NumReconfigured;
 		}
-		
-		if(bCreateNewComponent)
+		else
 		{
-			AActor* OwnerActor = SpawnedOwner.Get();
-			if (OwnerActor == nullptr)
-			{
-				OwnerActor = AttachComponent->GetOwner();
-				if (OwnerActor == nullptr)
-				{
-					// NOTE: This can happen with spawned systems
-					OwnerActor = AttachComponent->GetWorld()->SpawnActor<AActor>();
-					OwnerActor->SetFlags(RF_Transient);
-					SpawnedOwner = OwnerActor;
-				}
-			}
-			
-
-			int32 AnimeIndex = FMath::Min(PerParticleData.AnimIndex,Properties->Animations.Num() - 1);
-			int32 SkeletalIndex = FMath::Min(PerParticleData.VisTag,Properties->Animations.Num() - 1);
-			
-			SkeletalMeshComponent = NewObject<USkeletalMeshComponent>(OwnerActor);
-			SkeletalMeshComponent->SetFlags(RF_Transient);
-			SkeletalMeshComponent->SetupAttachment(AttachComponent);
-			SkeletalMeshComponent->RegisterComponent();
-			SkeletalMeshComponent->AddTickPrerequisiteComponent(AttachComponent);
-			SkeletalMeshComponent->SetSkeletalMesh(Properties->SkeletalMeshes[SkeletalIndex].SkeletalMesh);
-			SkeletalMeshComponent->OverrideAnimationData(Properties->Animations[AnimeIndex],true,false,0.0f);
-			SetSkeletalMaterials(Properties,SkeletalMeshComponent,Emitter,&PerParticleData);
-
-			if (Emitter->GetCachedEmitterData()->bLocalSpace)
-			{
-				SkeletalMeshComponent->SetAbsolute(false, false, false);
-			}
-			else
-			{
-				SkeletalMeshComponent->SetAbsolute(true, true, true);
-			}
+			SkeletalMeshComponent = CreateComponent(Properties, Emitter, AttachComponent, PendingCreation.SkeletalMesh, PendingCreation.AnimIndex);
+			++TickCounters.NumCreated;
 
 			if (PoolIndex >= 0)
 			{
 				// This should only happen if the component was destroyed externally
 				ComponentPool[PoolIndex].Component = SkeletalMeshComponent;
-				
+				ComponentPool[PoolIndex].bHasAppliedState = false;
+				ComponentPool[PoolIndex].AppliedMaterialEntry = INDEX_NONE;
 			}
 			else
 			{
 				// Add a new pool entry
-				PoolIndex = ComponentPool.Num();
-				ComponentPool.AddDefaulted_GetRef().Component = SkeletalMeshComponent;
-				
+				PoolIndex = AddPoolEntry(SkeletalMeshComponent);
 			}
 		}
-		
-		const FNiagaraLWCConverter LwcConverter = SystemInstance->GetLWCConverter(Emitter->GetCachedEmitterData()->bLocalSpace);
-		FVector Position = LwcConverter.ConvertSimulationPositionToWorld(PerParticleData.Position);
-		
-		SkeletalMeshComponent->SetFlags(RF_Transient);
-		SkeletalMeshComponent->SetupAttachment(AttachComponent);
-		SkeletalMeshComponent->AddTickPrerequisiteComponent(AttachComponent);
-		//SkeletalMeshComponent->SetSkeletalMesh(Properties->SkeletalMeshes[VisTag].SkeletalMesh);
-		
-		FTransform Transform(FRotator(PerParticleData.Rotate.X, PerParticleData.Rotate.Y, PerParticleData.Rotate.Z), Position, FVector(PerParticleData.Scale));
-		SkeletalMeshComponent->SetRelativeTransform(Transform);
-		SkeletalMeshComponent->SetVisibility(PerParticleData.Enabled);
-		//SkeletalMeshComponent->MeshObject->
-		SkeletalMeshComponent->SetActive(true);
-		SkeletalMeshComponent->SetPosition(PerParticleData.SkeletalAnimTime);
-
-		FComponentPoolEntry& PoolEntry = ComponentPool[PoolIndex];
-		PoolEntry.LastAssignedToParticleID = ParticleID;
-		++ComponentCount;
-		
-		if (ComponentCount >= MaxComponents)
+		if (Properties->bAssignComponentsOnParticleID)
 		{
-			// We've hit our prescribed limit
-			break;
+			ComponentPool.SetKey(PoolIndex, PendingCreation.PoolKey);
 		}
+		bPoolFull = FinishAssignment(SkeletalMeshComponent, PendingCreation.ParticleIndex, PoolIndex, PendingCreation.ParticleID);
+	}
+
+#if STATS || CSV_PROFILER
+	for (; CandidateIndex < NumCandidates; ++CandidateIndex)
+	{
+		const int32 ParticleIndex = bUseSelectedParticles ? SelectedParticles[CandidateIndex] : CandidateIndex;
+		TickCounters.NumDropped += ParticleBatch.Enabled[ParticleIndex] && (!bCullParticles || ParticleVisible[ParticleIndex]) ? 1 : 0;
 	}
+#endif
 	
-	//Free some component which they particle is dead
-	if (ComponentCount < ComponentPool.Num())
+	if (Properties->bSharePoses)
 	{
-		// go over the pooled components we didn't need this tick to see if we can destroy some and deactivate the rest
-		for (int32 PoolIndex = 0; PoolIndex < ComponentPool.Num(); ++PoolIndex)
-		{
-			FComponentPoolEntry& PoolEntry = ComponentPool[PoolIndex];
-			if (Properties->bAssignComponentsOnParticleID)
+		AssignPoseLeaders(Properties);
+	}
+
+	// Components without an animation to play have nothing to set a rate on
+	const bool bUseAnimInstance = Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance;
+	const bool bPlayAnimations = Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::PlayRate && Properties->Animations.Num() > 0;
+	const float DeltaSeconds = AttachComponent->GetWorld()->GetDeltaSeconds();
+	IAnimationBudgetAllocator* BudgetAllocator = Properties->bUseAnimationBudgetAllocator ? IAnimationBudgetAllocator::Get(AttachComponent->GetWorld()) : nullptr;
+	const bool bUseBudgetAllocator = BudgetAllocator != nullptr;
+
+	// Transforms, and whether they need applying at all, are pure functions of the particle data and the applied state cache
+	{
+		NIAGARA_SKELETAL_SCOPE(ComputeUpdates);
+		ParallelFor(TEXT("NiagaraSkeletal.ComputeComponentUpdates"), ComponentUpdates.Num(), GNiagaraSkeletalParallelForBatchSize,
+			[this, Properties, &SimulationSpace, bUseAnimInstance, bPlayAnimations, bUseBudgetAllocator, DeltaSeconds](int32 UpdateIndex)
 			{
-				if (PoolEntry.LastAssignedToParticleID >= 0)
+				using namespace NiagaraSkeletalRendererLocal;
+
+				FComponentUpdate& Update = ComponentUpdates[UpdateIndex];
+				const FComponentPoolEntry& PoolEntry = ComponentPool[Update.PoolIndex];
+				const int32 ParticleIndex = Update.ParticleIndex;
+
+				// attached components of local space emitters take the simulation position as their relative location
+				const FVector Position = SimulationSpace.ToSimulation(ParticleBatch.Position[ParticleIndex]);
+				const FVector3f& Rotate = ParticleBatch.Rotate[ParticleIndex];
+				const FVector3f& Scale = ParticleBatch.Scale[ParticleIndex];
+				Update.bTransformDirty = !PoolEntry.bHasAppliedState
+					|| !Position.Equals(PoolEntry.AppliedPosition, Properties->PositionUpdateTolerance)
+					|| !Rotate.Equals(PoolEntry.AppliedRotate, Properties->RotationUpdateTolerance)
+					|| !Scale.Equals(PoolEntry.AppliedScale, Properties->ScaleUpdateTolerance);
+				if (Update.bTransformDirty)
 				{
-					// This one's in use
-					continue;
+					Update.Transform = FTransform(FRotator(Rotate.X, Rotate.Y, Rotate.Z), Position, FVector(Scale));
 				}
-			}
-			else if (PoolIndex < ComponentCount)
-			{
-				continue;
-			}
 
-			USceneComponent* Component = PoolEntry.Component.Get();
-			if (!Component)
-			{
-				if (Component)
+				// pose leaders already got their time assigned, quantized unless they play on their own, followers don't play anything themselves
+				if (!Properties->bSharePoses)
 				{
-					Component->DestroyComponent();
+					Update.AnimTime = ParticleBatch.SkeletalAnimTime[ParticleIndex];
 				}
-
-				// destroy the component pool slot
-				ComponentPool.RemoveAtSwap(PoolIndex, 1, false);
-				--PoolIndex;
-				continue;
-			}
-			else if (Component->IsActive())
+				if (bUseAnimInstance)
+				{
+					// the anim instance gets the particle's state every tick and advances itself on the worker threads
+					Update.bAnimTimeDirty = false;
+				}
+				else if (bPlayAnimations)
+				{
+					// The component advances on its own at the rate the particle's anim time moves, it is only seeked when picked up or when it drifted,
+					// and whether it did can only be read on the game thread
+					const float AnimLength = AnimationLengths[ClampAnimIndex(Properties, ParticleBatch.AnimIndex[ParticleIndex])];
+					Update.AnimTime = WrapAnimTime(Update.AnimTime, AnimLength);
+					Update.ParticleAnimTime = WrapAnimTime(ParticleBatch.SkeletalAnimTime[ParticleIndex], AnimLength);
+					Update.PlayRate = PoolEntry.PlayRateTracker.GetPlayRate(Update.ParticleAnimTime, AnimLength, DeltaSeconds);
+					Update.bAnimTimeDirty = !Update.PoseLeader && !PoolEntry.bHasAppliedState;
+					Update.bCheckDrift = !Update.PoseLeader && PoolEntry.bHasAppliedState;
+					Update.bPlayRateDirty = !Update.PoseLeader && (!PoolEntry.bHasAppliedState || FMath::Abs(Update.PlayRate - PoolEntry.AppliedPlayRate) > Properties->PlayRateUpdateTolerance);
+				}
+				else
+				{
+					Update.bAnimTimeDirty = !Update.PoseLeader && (!PoolEntry.bHasAppliedState || FMath::Abs(Update.AnimTime - PoolEntry.AppliedAnimTime) > Properties->AnimTimeUpdateTolerance);
+				}
+
+				const int32 NumCustomDataFloats = Properties->NumCustomDataFloats;
+				Update.bCustomDataDirty = NumCustomDataFloats > 0 && (PoolEntry.AppliedCustomData.Num() != NumCustomDataFloats
+					|| FMemory::Memcmp(PoolEntry.AppliedCustomData.GetData(), &ParticleBatch.CustomData[ParticleIndex * NumCustomDataFloats], NumCustomDataFloats * sizeof(float)) != 0);
+
+				const USkeletalMesh* SkeletalMesh = Update.Component->GetSkeletalMeshAsset();
+				const float Radius = SkeletalMesh ? SkeletalMesh->GetBounds().SphereRadius * Scale.GetAbsMax() : 0.0f;
+				const FVector WorldPosition = SimulationSpace.ToWorld(ParticleBatch.Position[ParticleIndex]);
+				if (bUseBudgetAllocator)
+				{
+					const float Distance = FMath::Max(GetClosestViewDistance(WorldPosition), 1.0f);
+					switch (Properties->BudgetSignificance)
+					{
+					case ENiagaraSkeletalBudgetSignificance::Distance:
+						Update.Significance = 1.0f / Distance;
+						break;
+					case ENiagaraSkeletalBudgetSignificance::ScreenSize:
+						Update.Significance = Radius / Distance;
+						break;
+					default:
+						Update.Significance = ParticleBatch.Priority[ParticleIndex];
+						break;
+					}
+				}
+
+				if (Properties->AnimationLODs.Num() > 0)
+				{
+					Update.AnimationLOD = SelectAnimationLOD(Properties, WorldPosition, Radius);
+					// frozen components keep whatever pose they had
+					const bool bFrozen = Properties->AnimationLODs[Update.AnimationLOD].Mode == ENiagaraSkeletalAnimationLODMode::Frozen;
+					Update.bAnimTimeDirty &= !bFrozen;
+					Update.bCheckDrift &= !bFrozen;
+				}
+			});
+	}
+
+	// Apply pass, only the UObject mutation is left on the game thread. Render transforms marked dirty here are all sent together at the end of the frame
+	{
+		NIAGARA_SKELETAL_SCOPE(Apply);
+		for (const FComponentUpdate& Update : ComponentUpdates)
+		{
+			// Only issue the engine calls whose inputs changed since we last touched this component, each of them can dirty render state
+			FComponentPoolEntry& PoolEntry = ComponentPool[Update.PoolIndex];
+			USkeletalMeshComponent* SkeletalMeshComponent = Update.Component;
+			if (SkeletalMeshComponent->GetAttachParent() != AttachComponent)
 			{
-				Component->Deactivate();
-				Component->SetVisibility(false, true);
+				// the system's attach component changed since this component was set up
+				SkeletalMeshComponent->AttachToComponent(AttachComponent, FAttachmentTransformRules::KeepRelativeTransform);
+				SkeletalMeshComponent->AddTickPrerequisiteComponent(AttachComponent);
 			}
+
+			if (Update.bTransformDirty)
+			{
+				SkeletalMeshComponent->SetRelativeTransform(Update.Transform, false, nullptr, ETeleportType::TeleportPhysics);
+				PoolEntry.AppliedPosition = Update.Transform.GetLocation();
+				PoolEntry.AppliedRotate = ParticleBatch.Rotate[Update.ParticleIndex];
+				PoolEntry.AppliedScale = ParticleBatch.Scale[Update.ParticleIndex];
+			}
+		
+			if (!PoolEntry.bHasAppliedState)
+			{
+				SkeletalMeshComponent->SetVisibility(true);
+			}
+
+			// Materials are shared per mesh entry, so a component only needs them set when it changes entry or the entry's materials changed
+			const int32 MeshIndex = ParticleBatch.VisTag[Update.ParticleIndex];
+			if (PoolEntry.AppliedMaterialEntry != MeshIndex || PoolEntry.AppliedMaterialVersion != MeshMaterials[MeshIndex].Version)
+			{
+				SetSkeletalMaterials(PoolEntry, SkeletalMeshComponent, MeshIndex);
+			}
+			if (!SkeletalMeshComponent->IsActive())
+			{
+				SkeletalMeshComponent->SetActive(true);
+			}
+			if (USkeletalMeshComponentBudgeted* BudgetedComponent = BudgetAllocator ? Cast<USkeletalMeshComponentBudgeted>(SkeletalMeshComponent) : nullptr)
+			{
+				if (BudgetedComponent->GetAnimationBudgetHandle() == INDEX_NONE)
+				{
+					BudgetAllocator->RegisterComponent(BudgetedComponent);
+				}
+				BudgetAllocator->SetComponentSignificance(BudgetedComponent, Update.Significance);
+			}
+		
+			if (PoolEntry.bCullSuspended)
+			{
+				// back on screen, the animation LOD tier may have its own idea about ticking so it gets reapplied below
+				SkeletalMeshComponent->SetComponentTickEnabled(true);
+				PoolEntry.bCullSuspended = false;
+				PoolEntry.AppliedAnimationLOD = INDEX_NONE;
+			}
+			PoolEntry.CulledTime = -1.0;
+
+			if (PoolEntry.AppliedAnimationLOD != Update.AnimationLOD)
+			{
+				ApplyAnimationLOD(SkeletalMeshComponent, Properties->AnimationLODs.IsValidIndex(Update.AnimationLOD) ? &Properties->AnimationLODs[Update.AnimationLOD] : nullptr);
+				PoolEntry.AppliedAnimationLOD = Update.AnimationLOD;
+			}
+
+			if (Update.bCustomDataDirty)
+			{
+				// Only the values that changed are written, the component's render state is dirtied once however many there are
+				const int32 NumCustomDataFloats = Properties->NumCustomDataFloats;
+				const float* ParticleCustomData = &ParticleBatch.CustomData[Update.ParticleIndex * NumCustomDataFloats];
+				const bool bFirstWrite = PoolEntry.AppliedCustomData.Num() != NumCustomDataFloats;
+				PoolEntry.AppliedCustomData.SetNumZeroed(NumCustomDataFloats);
+				for (const FNiagaraSkeletalCustomDataLayout& Layout : Properties->CustomDataLayouts)
+				{
+					for (int32 FloatIndex = 0; FloatIndex < Layout.NumFloats; ++FloatIndex)
+					{
+						const int32 PackedIndex = Layout.PackedOffset + FloatIndex;
+						if (bFirstWrite || PoolEntry.AppliedCustomData[PackedIndex] != ParticleCustomData[PackedIndex])
+						{
+							SkeletalMeshComponent->SetCustomPrimitiveDataFloat(Layout.CustomDataIndex + FloatIndex, ParticleCustomData[PackedIndex]);
+							PoolEntry.AppliedCustomData[PackedIndex] = ParticleCustomData[PackedIndex];
+						}
+					}
+				}
+			}
+
+			bool bAnimTimeDirty = Update.bAnimTimeDirty;
+			if (PoolEntry.AppliedPoseLeader.Get() != Update.PoseLeader)
+			{
+				SkeletalMeshComponent->SetLeaderPoseComponent(Update.PoseLeader);
+				PoolEntry.AppliedPoseLeader = Update.PoseLeader;
+				// a component that stops following has to be put back at its own time
+				bAnimTimeDirty |= !Update.PoseLeader;
+			}
+
+			if (bUseAnimInstance && !Update.PoseLeader)
+			{
+				if (UNiagaraSkeletalAnimInstance* AnimInstance = Cast<UNiagaraSkeletalAnimInstance>(SkeletalMeshComponent->GetAnimInstance()))
+				{
+					FNiagaraSkeletalAnimState AnimState;
+					AnimState.AnimIndex = ClampAnimIndex(Properties, ParticleBatch.AnimIndex[Update.ParticleIndex]);
+					AnimState.AnimTime = Update.AnimTime;
+					AnimState.BlendParameters = ParticleBatch.AnimBlendParameters[Update.ParticleIndex];
+					// a particle that just picked the component up starts on its animation instead of fading in from the last owner's
+					AnimInstance->SetParticleState(AnimState, !PoolEntry.bHasAppliedState);
+				}
+			}
+			else if (Update.bCheckDrift && !bAnimTimeDirty)
+			{
+				const float AnimLength = AnimationLengths[ClampAnimIndex(Properties, ParticleBatch.AnimIndex[Update.ParticleIndex])];
+				bAnimTimeDirty = FMath::Abs(NiagaraSkeletalRendererLocal::GetAnimTimeDelta(SkeletalMeshComponent->GetPosition(), Update.AnimTime, AnimLength)) > Properties->AnimationDriftTolerance;
+			}
+			if (Update.bPlayRateDirty)
+			{
+				SkeletalMeshComponent->SetPlayRate(Update.PlayRate);
+				PoolEntry.AppliedPlayRate = Update.PlayRate;
+			}
+		
+			if (bAnimTimeDirty)
+			{
+				SkeletalMeshComponent->SetPosition(Update.AnimTime);
+				PoolEntry.AppliedAnimTime = Update.AnimTime;
+			}
+			PoolEntry.PlayRateTracker.Record(Update.ParticleAnimTime);
+			PoolEntry.bHasAppliedState = true;
+			PoolEntry.LastActiveTime = CurrentTime;
+		}
+	}
+	
+	//Free some component which they particle is dead
+	if (ComponentCount < ComponentPool.Num())
+	{
+		NIAGARA_SKELETAL_SCOPE(Cleanup);
+		// Idle components are only trimmed once the pool has grown past the retained count plus some hysteresis, then it is shrunk back down to the retained count
+		// in one go, so a pool hovering around the limit doesn't keep destroying and recreating components
+		const int32 MinRetainedComponents = FMath::Max(Properties->MinRetainedComponents, 0);
+		const bool bTrimIdleComponents = Properties->IdleComponentTimeout > 0.0f && ComponentPool.Num() > MinRetainedComponents + FMath::Max(Properties->IdleTrimHysteresis, 0);
+		
+		// go over the pooled components we didn't need this tick to see if we can destroy some and deactivate the rest. Without
+		// particle IDs the first ComponentCount entries were handed out in order
+		const int32 NumInUseByIndex = Properties->bAssignComponentsOnParticleID ? 0 : ComponentCount;
+		ComponentPool.TrimUnused(NumInUseByIndex, [&](int32 PoolIndex, FComponentPoolEntry& PoolEntry)
+		{
+			USceneComponent* Component = PoolEntry.Component.Get();
+			if (!Component)
+			{
+				// destroy the component pool slot
+				return true;
+			}
+			else if (bTrimIdleComponents && ComponentPool.Num() > MinRetainedComponents && CurrentTime - PoolEntry.LastActiveTime > Properties->IdleComponentTimeout)
+			{
+				// Trimming is about getting the memory back, so these skip the world pool
+				Component->DestroyComponent();
+				++TickCounters.NumDestroyed;
+				return true;
+			}
+			DeactivatePoolEntry(PoolIndex);
+			return false;
+		});
+	}
+
+	PublishTickCounters(ComponentCount);
+	if (NiagaraSkeletalBenchmark::IsEnabled())
+	{
+		NiagaraSkeletalBenchmark::AddTick(TickCounters, NumParticles, ComponentCount, ComponentPool.Num(), GetContainerAllocatedSize() - ContainerSizeAtStart);
+	}
+	// counting starts over here rather than at the top of the tick, so components prewarmed before it are reported with it
+	TickCounters = FNiagaraSkeletalTickCounters();
+}
+
+int64 FNiagaraRendererSkeletal::GetContainerAllocatedSize() const
+{
+	int64 AllocatedSize = ComponentPool.GetAllocatedSize() + ComponentUpdates.GetAllocatedSize() + PoseLeaders.GetAllocatedSize()
+		+ ViewLocations.GetAllocatedSize() + ViewFrustums.GetAllocatedSize() + ParticleVisible.GetAllocatedSize() + ParticlePriorities.GetAllocatedSize()
+		+ SelectedParticles.GetAllocatedSize() + ParticleBatch.GetAllocatedSize();
+	for (const FComponentPoolEntry& PoolEntry : ComponentPool)
+	{
+		AllocatedSize += PoolEntry.AppliedCustomData.GetAllocatedSize();
+	}
+	AllocatedSize += InstancedMeshes.GetAllocatedSize() + InstancesToRemove.GetAllocatedSize() + InstanceTransformsToSend.GetAllocatedSize();
+	for (const FInstancedMeshEntry& InstancedMesh : InstancedMeshes)
+	{
+		AllocatedSize += InstancedMesh.InstanceTransforms.GetAllocatedSize() + InstancedMesh.InstanceCustomData.GetAllocatedSize()
+			+ InstancedMesh.AppliedTransforms.GetAllocatedSize() + InstancedMesh.AppliedCustomData.GetAllocatedSize();
+	}
+	return AllocatedSize;
+}
+
+void FNiagaraRendererSkeletal::PublishTickCounters(int32 NumLiveComponents)
+{
+	// Every renderer adds its own numbers, the stats and CSV rows are totals for the frame
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_LiveComponents, NumLiveComponents);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_PooledComponents, ComponentPool.Num());
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_PoolHits, TickCounters.NumPoolHits);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_PoolMisses, TickCounters.NumPoolMisses);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Created, TickCounters.NumCreated);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Reconfigured, TickCounters.NumReconfigured);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Destroyed, TickCounters.NumDestroyed);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Dropped, TickCounters.NumDropped);
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Pending, TickCounters.NumPending);
+
+	CSV_CUSTOM_STAT(NiagaraSkeletal, LiveComponents, NumLiveComponents, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, PooledComponents, ComponentPool.Num(), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, PoolHits, TickCounters.NumPoolHits, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, PoolMisses, TickCounters.NumPoolMisses, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, Created, TickCounters.NumCreated, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, Reconfigured, TickCounters.NumReconfigured, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, Destroyed, TickCounters.NumDestroyed, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, Dropped, TickCounters.NumDropped, ECsvCustomStatOp::Accumulate);
+
+#if STATS || CSV_PROFILER
+	// An estimate of what the pool holds on to: the components themselves and their bone buffers, plus our own bookkeeping
+	int64 PoolMemory = ComponentPool.GetAllocatedSize() + ComponentUpdates.GetAllocatedSize();
+	for (const FComponentPoolEntry& PoolEntry : ComponentPool)
+	{
+		PoolMemory += PoolEntry.AppliedCustomData.GetAllocatedSize();
+		if (const USkeletalMeshComponent* Component = PoolEntry.Component.Get())
+		{
+			PoolMemory += Component->GetClass()->GetStructureSize() + Component->GetComponentSpaceTransforms().GetAllocatedSize() + Component->GetBoneSpaceTransforms().GetAllocatedSize();
 		}
 	}
+	DEC_MEMORY_STAT_BY(STAT_NiagaraSkeletal_PoolMemory, ReportedPoolMemory);
+	INC_MEMORY_STAT_BY(STAT_NiagaraSkeletal_PoolMemory, PoolMemory);
+	ReportedPoolMemory = PoolMemory;
+	CSV_CUSTOM_STAT(NiagaraSkeletal, PoolMemoryKB, float(double(PoolMemory) / 1024.0), ECsvCustomStatOp::Accumulate);
+#endif
 }
 
 void FNiagaraRendererSkeletal::OnSystemComplete_GameThread(const UNiagaraRendererProperties* InProperties, const FNiagaraEmitterInstance* Emitter)
@@ -343,31 +983,778 @@ void FNiagaraRendererSkeletal::OnSystemComplete_GameThread(const UNiagaraRendere
 	ResetComponentPool(true);
 }
 
-void FNiagaraRendererSkeletal::SetSkeletalMaterials(const UNiagaraSkeletalRendererProperties* Properties,USkeletalMeshComponent* SkeletalMeshComponent,const FNiagaraEmitterInstance* Emitter,FNiagaraParticleData* PerParticleData)
+void FNiagaraRendererSkeletal::AssignPoseLeaders(const UNiagaraSkeletalRendererProperties* Properties)
 {
-	
+	// Buckets are rebuilt every tick, the first component of a bucket in buffer order leads it
+	PoseLeaders.Reset();
+	const float TimeStep = Properties->PoseSharingTimeStep;
+	// playing leaders advance on their own, their play rate would alternate if it followed the quantized time
+	const bool bQuantizeLeaders = TimeStep > UE_SMALL_NUMBER && Properties->AnimationPlayback != ENiagaraSkeletalAnimationPlayback::PlayRate;
+	for (FComponentUpdate& Update : ComponentUpdates)
+	{
+		const float AnimTime = ParticleBatch.SkeletalAnimTime[Update.ParticleIndex];
+		const int32 TimeBucket = TimeStep > UE_SMALL_NUMBER ? FMath::FloorToInt(AnimTime / TimeStep) : FMath::FloorToInt(AnimTime * 1000.0f);
+		// out of range indices show the clamped animation, so they share its poses
+		const FPoseKey PoseKey(Update.Component->GetSkeletalMeshAsset(), ClampAnimIndex(Properties, ParticleBatch.AnimIndex[Update.ParticleIndex]), TimeBucket);
+
+		USkeletalMeshComponent*& Leader = PoseLeaders.FindOrAdd(PoseKey, nullptr);
+		if (Leader)
+		{
+			Update.PoseLeader = Leader;
+		}
+		else
+		{
+			// the leader shows the bucket's time so its pose doesn't depend on which particle happened to come first
+			Leader = Update.Component;
+			Update.PoseLeader = nullptr;
+			Update.AnimTime = bQuantizeLeaders ? float(TimeBucket) * TimeStep : AnimTime;
+		}
+	}
+}
+
+bool FNiagaraRendererSkeletal::ComputeParticleVisibility(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraSkeletalSimulationSpace& SimulationSpace, UWorld* World)
+{
+	NIAGARA_SKELETAL_SCOPE(Cull);
+	// Only player cameras are known on the game thread, without any (editor viewports, servers) nothing is culled
+	ViewFrustums.Reset();
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		if (!PlayerController || !PlayerController->IsLocalController() || !PlayerController->PlayerCameraManager)
+		{
+			continue;
+		}
+
+		FMatrix ViewMatrix, ProjectionMatrix, ViewProjectionMatrix;
+		UGameplayStatics::GetViewProjectionMatrix(PlayerController->PlayerCameraManager->GetCameraCacheView(), ViewMatrix, ProjectionMatrix, ViewProjectionMatrix);
+		GetViewFrustumBounds(ViewFrustums.AddDefaulted_GetRef(), ViewProjectionMatrix, false);
+	}
+	if (ViewFrustums.Num() == 0)
+	{
+		return false;
+	}
+
+	const int32 NumParticles = ParticleBatch.Num();
+	ParticleVisible.SetNumUninitialized(NumParticles, false);
+	ParallelFor(TEXT("NiagaraSkeletal.CullParticles"), NumParticles, GNiagaraSkeletalParallelForBatchSize,
+		[this, Properties, &SimulationSpace](int32 ParticleIndex)
+		{
+			const USkeletalMesh* SkeletalMesh = GetResolvedMesh(ParticleBatch.VisTag[ParticleIndex]);
+			const FVector Position = SimulationSpace.ToWorld(ParticleBatch.Position[ParticleIndex]);
+			const float Radius = SkeletalMesh ? SkeletalMesh->GetBounds().SphereRadius * ParticleBatch.Scale[ParticleIndex].GetAbsMax() : 0.0f;
+
+			bool bVisible = false;
+			for (const FConvexVolume& ViewFrustum : ViewFrustums)
+			{
+				if (ViewFrustum.IntersectSphere(Position, Radius))
+				{
+					bVisible = true;
+					break;
+				}
+			}
+			ParticleVisible[ParticleIndex] = bVisible;
+		});
+	return true;
+}
+
+void FNiagaraRendererSkeletal::SuspendCulledPoolEntry(const UNiagaraSkeletalRendererProperties* Properties, int32 PoolIndex, double CurrentTime)
+{
+	FComponentPoolEntry& PoolEntry = ComponentPool[PoolIndex];
+	if (PoolEntry.CulledTime < 0.0)
+	{
+		PoolEntry.CulledTime = CurrentTime;
+	}
+
+	if (CurrentTime - PoolEntry.CulledTime >= Properties->CulledComponentReleaseDelay)
+	{
+		DeactivatePoolEntry(PoolIndex);
+		ComponentPool.Release(PoolIndex);
+		return;
+	}
+
+	if (!PoolEntry.bCullSuspended)
+	{
+		if (USkeletalMeshComponent* Component = PoolEntry.Component.Get())
+		{
+			// the allocator would turn the tick back on
+			UnregisterFromBudget(Component);
+			Component->SetComponentTickEnabled(false);
+		}
+		PoolEntry.bCullSuspended = true;
+	}
+}
+
+bool FNiagaraRendererSkeletal::SelectPriorityParticles(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraSkeletalSimulationSpace& SimulationSpace, bool bCullParticles)
+{
+	const int32 NumParticles = ParticleBatch.Num();
+	const int32 MaxComponents = Properties->ComponentCountLimit;
+	const float HysteresisScale = 1.0f + FMath::Max(Properties->PriorityHysteresis, 0.0f);
+	NIAGARA_SKELETAL_SCOPE(Prioritize);
+
+	// Score everyone who could take a component, roughly by screen size so near and big particles win
+	ParticlePriorities.Reset();
+	for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+	{
+		const USkeletalMesh* SkeletalMesh = GetResolvedMesh(ParticleBatch.VisTag[ParticleIndex]);
+		// culled particles don't compete, the ones holding a component keep it through the cull grace period
+		if (!ParticleBatch.Enabled[ParticleIndex] || (bCullParticles && !ParticleVisible[ParticleIndex]) || !SkeletalMesh)
+		{
+			continue;
+		}
+
+		const FVector Position = SimulationSpace.ToWorld(ParticleBatch.Position[ParticleIndex]);
+		double DistanceSquared = ViewLocations.Num() > 0 ? UE_BIG_NUMBER : 1.0;
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(ViewLocation, Position));
+		}
+		const float Radius = SkeletalMesh->GetBounds().SphereRadius * ParticleBatch.Scale[ParticleIndex].GetAbsMax();
+		float Score = ParticleBatch.Priority[ParticleIndex] * Radius / FMath::Max(float(FMath::Sqrt(DistanceSquared)), 1.0f);
+		Score = FMath::IsFinite(Score) ? Score : 0.0f;
+
+		// particles that already own a component keep it unless someone is clearly more important
+		if (Properties->bAssignComponentsOnParticleID && ComponentPool.FindSlot(ParticleBatch.UniqueID[ParticleIndex]) != INDEX_NONE)
+		{
+			Score *= HysteresisScale;
+		}
+		ParticlePriorities.Add({ Score, ParticleIndex });
+	}
+
+	if (ParticlePriorities.Num() <= MaxComponents)
+	{
+		return false;
+	}
+
+	NiagaraSkeletalRendererLocal::SelectHighestScores(MakeArrayView(ParticlePriorities), MaxComponents);
+	TickCounters.NumDropped += ParticlePriorities.Num() - MaxComponents;
+
+	// Only the winners are sorted, to keep assigning in buffer order
+	SelectedParticles.Reset();
+	for (int32 Index = 0; Index < MaxComponents; ++Index)
+	{
+		SelectedParticles.Add(ParticlePriorities[Index].ParticleIndex);
+	}
+	SelectedParticles.Sort();
+
+	// Losers give their components back now, otherwise their reserved slots would keep the winners from getting one
+	if (Properties->bAssignComponentsOnParticleID)
+	{
+		for (int32 Index = MaxComponents; Index < ParticlePriorities.Num(); ++Index)
+		{
+			const int32 PoolIndex = ComponentPool.FindSlot(ParticleBatch.UniqueID[ParticlePriorities[Index].ParticleIndex]);
+			if (PoolIndex != INDEX_NONE)
+			{
+				DeactivatePoolEntry(PoolIndex);
+				ComponentPool.Release(PoolIndex);
+			}
+		}
+	}
+	return true;
+}
+
+int32 FNiagaraRendererSkeletal::SelectAnimationLOD(const UNiagaraSkeletalRendererProperties* Properties, const FVector& Position, float Radius) const
+{
+	// without any view, e.g. on a server, there's no one to save the animation cost for
+	if (ViewLocations.Num() == 0)
+	{
+		return 0;
+	}
+
+	const float Distance = GetClosestViewDistance(Position);
+	// same as the engine's screen size for a 90 degree field of view
+	const float ScreenSize = Distance > UE_KINDA_SMALL_NUMBER ? Radius / Distance : UE_BIG_NUMBER;
+
+	const TArray<FNiagaraSkeletalAnimationLOD>& AnimationLODs = Properties->AnimationLODs;
+	for (int32 LODIndex = 0; LODIndex < AnimationLODs.Num() - 1; ++LODIndex)
+	{
+		const bool bInTier = Properties->AnimationLODMetric == ENiagaraSkeletalAnimationLODMetric::Distance
+			? Distance <= AnimationLODs[LODIndex].Threshold
+			: ScreenSize >= AnimationLODs[LODIndex].Threshold;
+		if (bInTier)
+		{
+			return LODIndex;
+		}
+	}
+	return AnimationLODs.Num() - 1;
+}
+
+void FNiagaraRendererSkeletal::ApplyAnimationLOD(USkeletalMeshComponent* Component, const FNiagaraSkeletalAnimationLOD* AnimationLOD)
+{
+	Component->SetForcedLOD(AnimationLOD ? FMath::Max(AnimationLOD->ForcedMeshLOD, 0) : 0);
+	if (Component->IsA<USkeletalMeshComponentBudgeted>())
+	{
+		// the animation budget allocator owns the tick rate of these
+		return;
+	}
+
+	const ENiagaraSkeletalAnimationLODMode Mode = AnimationLOD ? AnimationLOD->Mode : ENiagaraSkeletalAnimationLODMode::FullRate;
+
+	// Reduced rates go through the same external update rate control the animation budget allocator uses
+	const bool bReducedRate = Mode == ENiagaraSkeletalAnimationLODMode::ReducedRate;
+	if (bReducedRate)
+	{
+		Component->bEnableUpdateRateOptimizations = true;
+		Component->SetExternalTickRate(uint8(FMath::Clamp(AnimationLOD->UpdateRate, 1, 255)));
+		Component->EnableExternalInterpolation(AnimationLOD->bInterpolate);
+	}
+	Component->EnableExternalTickRateControl(bReducedRate);
+
+	Component->SetComponentTickEnabled(Mode != ENiagaraSkeletalAnimationLODMode::Frozen);
+}
+
+float FNiagaraRendererSkeletal::GetClosestViewDistance(const FVector& Position) const
+{
+	double DistanceSquared = UE_BIG_NUMBER;
+	for (const FVector& ViewLocation : ViewLocations)
+	{
+		DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(ViewLocation, Position));
+	}
+	return float(FMath::Sqrt(DistanceSquared));
+}
+
+UClass* FNiagaraRendererSkeletal::GetComponentClass(const UNiagaraSkeletalRendererProperties* Properties)
+{
+	return Properties->bUseAnimationBudgetAllocator ? USkeletalMeshComponentBudgeted::StaticClass() : USkeletalMeshComponent::StaticClass();
+}
+
+void FNiagaraRendererSkeletal::UnregisterFromBudget(USkeletalMeshComponent* Component)
+{
+	USkeletalMeshComponentBudgeted* BudgetedComponent = Cast<USkeletalMeshComponentBudgeted>(Component);
+	if (BudgetedComponent && BudgetedComponent->GetAnimationBudgetHandle() != INDEX_NONE)
+	{
+		if (IAnimationBudgetAllocator* BudgetAllocator = IAnimationBudgetAllocator::Get(BudgetedComponent->GetWorld()))
+		{
+			BudgetAllocator->UnregisterComponent(BudgetedComponent);
+		}
+	}
+}
+
+int32 FNiagaraRendererSkeletal::TickInstancedMeshes(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, bool bIsRendererEnabled)
+{
+	using namespace NiagaraSkeletalVertexAnimation;
+	NIAGARA_SKELETAL_SCOPE(InstancedMeshes);
+
+	// the instanced mesh components are absolute at the origin, so the instances go in world space
+	const FNiagaraSkeletalSimulationSpace SimulationSpace(Emitter);
+	const int32 NumMeshes = FMath::Min(Properties->SkeletalMeshes.Num(), Properties->VertexAnimationBakes.Num());
+	const bool bSkinned = Properties->RenderMode == ENiagaraSkeletalRenderMode::InstancedSkinned;
+	// entries past the end belong to meshes that were removed from the properties
+	for (int32 MeshIndex = NumMeshes; MeshIndex < InstancedMeshes.Num(); ++MeshIndex)
+	{
+		if (UInstancedStaticMeshComponent* Component = InstancedMeshes[MeshIndex].Component.Get())
+		{
+			Component->DestroyComponent();
+			++TickCounters.NumDestroyed;
+		}
+	}
+	InstancedMeshes.SetNum(NumMeshes, false);
+	for (FInstancedMeshEntry& InstancedMesh : InstancedMeshes)
+	{
+		InstancedMesh.InstanceTransforms.Reset();
+		InstancedMesh.InstanceCustomData.Reset();
+	}
+
+	// Bucket the particles by mesh, the instance lists are rebuilt from scratch every tick so there's no per particle state to keep
+	const int32 NumParticles = bIsRendererEnabled ? ParticleBatch.Num() : 0;
+	for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+	{
+		const int32 MeshIndex = ParticleBatch.VisTag[ParticleIndex];
+		if (!ParticleBatch.Enabled[ParticleIndex] || !InstancedMeshes.IsValidIndex(MeshIndex))
+		{
+			continue;
+		}
+
+		const FNiagaraSkeletalVertexAnimationBake& Bake = Properties->VertexAnimationBakes[MeshIndex];
+		// a bake left over from the other baked mode is useless to the materials of this one
+		if (!Bake.IsValid() || Bake.IsSkinned() != bSkinned || Bake.Animations.Num() == 0)
+		{
+			continue;
+		}
+
+		const FVector3f& Rotate = ParticleBatch.Rotate[ParticleIndex];
+		FInstancedMeshEntry& InstancedMesh = InstancedMeshes[MeshIndex];
+		InstancedMesh.InstanceTransforms.Emplace(FRotator(Rotate.X, Rotate.Y, Rotate.Z), SimulationSpace.ToWorld(ParticleBatch.Position[ParticleIndex]), FVector(ParticleBatch.Scale[ParticleIndex]));
+
+		const int32 AnimIndex = FMath::Clamp(ParticleBatch.AnimIndex[ParticleIndex], 0, Bake.Animations.Num() - 1);
+		int32 FrameA, FrameB;
+		float Blend;
+		SampleAnimation(Bake.Animations[AnimIndex], ParticleBatch.SkeletalAnimTime[ParticleIndex], FrameA, FrameB, Blend);
+		InstancedMesh.InstanceCustomData.Add(float(FrameA));
+		InstancedMesh.InstanceCustomData.Add(float(FrameB));
+		InstancedMesh.InstanceCustomData.Add(Blend);
+	}
+
+	int32 NumLiveComponents = 0;
+	for (int32 MeshIndex = 0; MeshIndex < NumMeshes; ++MeshIndex)
+	{
+		FInstancedMeshEntry& InstancedMesh = InstancedMeshes[MeshIndex];
+		UInstancedStaticMeshComponent* Component = InstancedMesh.Component.Get();
+		const int32 NumInstances = InstancedMesh.InstanceTransforms.Num();
+		if (!Component)
+		{
+			if (NumInstances == 0)
+			{
+				continue;
+			}
+			Component = CreateInstancedMeshComponent(Properties, Emitter, AttachComponent, MeshIndex);
+			InstancedMesh.Component = Component;
+			InstancedMesh.AppliedTransforms.Reset();
+			InstancedMesh.AppliedCustomData.Reset();
+			++TickCounters.NumCreated;
+		}
+		else if (NumInstances == 0 && Component->GetInstanceCount() == 0)
+		{
+			continue;
+		}
+		NumLiveComponents += NumInstances > 0 ? 1 : 0;
+
+		// Nothing is sent when no particle moved or advanced its animation. Of the instances the component keeps, only the range from the first
+		// to the last one that moved is sent, instances it doesn't have yet get their transform when they're added
+		const int32 NumExistingInstances = Component->GetInstanceCount();
+		const bool bCountChanged = NumInstances != NumExistingInstances || InstancedMesh.AppliedTransforms.Num() != NumInstances;
+		const int32 NumKeptInstances = FMath::Min(NumInstances, NumExistingInstances);
+		const int32 NumKnownInstances = FMath::Min(NumKeptInstances, InstancedMesh.AppliedTransforms.Num());
+		int32 FirstMovedInstance = NumKnownInstances < NumKeptInstances ? NumKnownInstances : INDEX_NONE;
+		int32 LastMovedInstance = NumKnownInstances < NumKeptInstances ? NumKeptInstances - 1 : INDEX_NONE;
+		for (int32 InstanceIndex = 0; InstanceIndex < NumKnownInstances; ++InstanceIndex)
+		{
+			if (!InstancedMesh.InstanceTransforms[InstanceIndex].Equals(InstancedMesh.AppliedTransforms[InstanceIndex]))
+			{
+				FirstMovedInstance = FirstMovedInstance == INDEX_NONE ? InstanceIndex : FMath::Min(FirstMovedInstance, InstanceIndex);
+				LastMovedInstance = FMath::Max(LastMovedInstance, InstanceIndex);
+			}
+		}
+		const bool bTransformsChanged = bCountChanged || FirstMovedInstance != INDEX_NONE;
+		const bool bCustomDataChanged = bCountChanged || FMemory::Memcmp(InstancedMesh.InstanceCustomData.GetData(), InstancedMesh.AppliedCustomData.GetData(), InstancedMesh.InstanceCustomData.Num() * sizeof(float)) != 0;
+		if (!bTransformsChanged && !bCustomDataChanged)
+		{
+			continue;
+		}
+
+		// Resize the instance list at the tail only, then overwrite what changed in one batch and dirty the render state once
+		if (NumInstances == 0)
+		{
+			Component->ClearInstances();
+		}
+		else if (NumInstances < NumExistingInstances)
+		{
+			InstancesToRemove.Reset();
+			for (int32 InstanceIndex = NumExistingInstances - 1; InstanceIndex >= NumInstances; --InstanceIndex)
+			{
+				InstancesToRemove.Add(InstanceIndex);
+			}
+			Component->RemoveInstances(InstancesToRemove);
+		}
+		else if (NumInstances > NumExistingInstances)
+		{
+			InstanceTransformsToSend.Reset();
+			InstanceTransformsToSend.Append(InstancedMesh.InstanceTransforms.GetData() + NumExistingInstances, NumInstances - NumExistingInstances);
+			Component->AddInstances(InstanceTransformsToSend, false, true);
+		}
+
+		if (FirstMovedInstance != INDEX_NONE)
+		{
+			InstanceTransformsToSend.Reset();
+			InstanceTransformsToSend.Append(InstancedMesh.InstanceTransforms.GetData() + FirstMovedInstance, LastMovedInstance - FirstMovedInstance + 1);
+			Component->BatchUpdateInstancesTransforms(FirstMovedInstance, InstanceTransformsToSend, true, false, true);
+		}
+		if (NumInstances > 0 && bCustomDataChanged)
+		{
+			// instances the component had before keep their data, only the ones that moved to another frame are rewritten
+			const int32 NumAppliedInstances = FMath::Min(NumExistingInstances, InstancedMesh.AppliedCustomData.Num() / NumCustomDataFloats);
+			for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+			{
+				const float* CustomData = InstancedMesh.InstanceCustomData.GetData() + InstanceIndex * NumCustomDataFloats;
+				if (InstanceIndex >= NumAppliedInstances || FMemory::Memcmp(CustomData, InstancedMesh.AppliedCustomData.GetData() + InstanceIndex * NumCustomDataFloats, NumCustomDataFloats * sizeof(float)) != 0)
+				{
+					Component->SetCustomData(InstanceIndex, MakeArrayView(CustomData, NumCustomDataFloats), false);
+				}
+			}
+		}
+		Component->MarkRenderStateDirty();
+		Swap(InstancedMesh.InstanceTransforms, InstancedMesh.AppliedTransforms);
+		Swap(InstancedMesh.InstanceCustomData, InstancedMesh.AppliedCustomData);
+	}
+	return NumLiveComponents;
+}
+
+UInstancedStaticMeshComponent* FNiagaraRendererSkeletal::CreateInstancedMeshComponent(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, int32 MeshIndex)
+{
+	using namespace NiagaraSkeletalVertexAnimation;
+
+	const FNiagaraSkeletalVertexAnimationBake& Bake = Properties->VertexAnimationBakes[MeshIndex];
+	AActor* OwnerActor = FindOrSpawnOwner(AttachComponent);
+
+	UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(OwnerActor);
+	Component->SetFlags(RF_Transient);
+	Component->SetupAttachment(AttachComponent);
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetCanEverAffectNavigation(false);
+	Component->NumCustomDataFloats = NumCustomDataFloats;
+	Component->SetStaticMesh(Bake.StaticMesh);
+	Component->SetAbsolute(true, true, true);
+	Component->SetWorldTransform(FTransform::Identity);
+	Component->RegisterComponent();
+	Component->AddTickPrerequisiteComponent(AttachComponent);
+
+	// The baked textures are per mesh, so every slot gets its own MID even when they share one material
+	UTexture2D* AnimationTexture = Bake.GetAnimationTexture();
+	const FLinearColor TextureSize(float(AnimationTexture->GetSizeX()), float(AnimationTexture->GetSizeY()), 0.0f, 0.0f);
+	for (int32 MaterialIndex = 0; MaterialIndex < Component->GetNumMaterials(); ++MaterialIndex)
+	{
+		UMaterialInterface* BaseMaterial = Properties->VertexAnimationMaterial ? Properties->VertexAnimationMaterial.Get() : Component->GetMaterial(MaterialIndex);
+		UMaterialInstanceDynamic* MaterialInstance = UMaterialInstanceDynamic::Create(BaseMaterial, Component);
+		if (!MaterialInstance)
+		{
+			continue;
+		}
+		if (Bake.IsSkinned())
+		{
+			MaterialInstance->SetTextureParameterValue(BoneTextureParamName, Bake.BoneTexture);
+		}
+		else
+		{
+			MaterialInstance->SetTextureParameterValue(PositionTextureParamName, Bake.PositionTexture);
+			MaterialInstance->SetTextureParameterValue(NormalTextureParamName, Bake.NormalTexture);
+		}
+		MaterialInstance->SetVectorParameterValue(TextureSizeParamName, TextureSize);
+		MaterialInstance->SetScalarParameterValue(RowsPerFrameParamName, float(Bake.RowsPerFrame));
+		Component->SetMaterial(MaterialIndex, MaterialInstance);
+	}
+	return Component;
+}
+
+int32 FNiagaraRendererSkeletal::ResetInstancedMeshes()
+{
+	int32 NumDestroyed = 0;
+	for (FInstancedMeshEntry& InstancedMesh : InstancedMeshes)
+	{
+		if (UInstancedStaticMeshComponent* Component = InstancedMesh.Component.Get())
+		{
+			Component->DestroyComponent();
+			++NumDestroyed;
+		}
+	}
+	InstancedMeshes.Reset();
+	return NumDestroyed;
+}
+
+AActor* FNiagaraRendererSkeletal::FindOrSpawnOwner(USceneComponent* AttachComponent)
+{
+	AActor* OwnerActor = SpawnedOwner.Get();
+	if (OwnerActor == nullptr)
+	{
+		OwnerActor = AttachComponent->GetOwner();
+		if (OwnerActor == nullptr)
+		{
+			// NOTE: This can happen with spawned systems
+			OwnerActor = AttachComponent->GetWorld()->SpawnActor<AActor>();
+			OwnerActor->SetFlags(RF_Transient);
+			SpawnedOwner = OwnerActor;
+		}
+	}
+	return OwnerActor;
+}
+
+USkeletalMeshComponent* FNiagaraRendererSkeletal::CreateComponent(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, USkeletalMesh* SkeletalMesh, int32 AnimIndex)
+{
+	NIAGARA_SKELETAL_SCOPE(Create);
+	AActor* OwnerActor = FindOrSpawnOwner(AttachComponent);
+
+	// A component parked by any skeletal renderer in this world already has the mesh set up, which is the expensive part
+	UNiagaraSkeletalComponentPoolSubsystem* WorldPool = bUseWorldComponentPool && UNiagaraSkeletalComponentPoolSubsystem::IsEnabled() ? OwnerActor->GetWorld()->GetSubsystem<UNiagaraSkeletalComponentPoolSubsystem>() : nullptr;
+	UClass* ComponentClass = GetComponentClass(Properties);
+	USkeletalMeshComponent* SkeletalMeshComponent = WorldPool ? WorldPool->Acquire(SkeletalMesh, ComponentClass, OwnerActor) : nullptr;
+	const bool bFromWorldPool = SkeletalMeshComponent != nullptr;
+	if (!bFromWorldPool)
+	{
+		SkeletalMeshComponent = NewObject<USkeletalMeshComponent>(OwnerActor, ComponentClass);
+	}
+	if (USkeletalMeshComponentBudgeted* BudgetedComponent = Cast<USkeletalMeshComponentBudgeted>(SkeletalMeshComponent))
+	{
+		// registered by the apply pass once a particle shows it, with that particle's significance
+		BudgetedComponent->SetAutoRegisterWithBudgetAllocator(false);
+	}
+	SkeletalMeshComponent->SetFlags(RF_Transient);
+	SkeletalMeshComponent->SetupAttachment(AttachComponent);
+	SkeletalMeshComponent->RegisterComponent();
+	SkeletalMeshComponent->AddTickPrerequisiteComponent(AttachComponent);
+	if (!bFromWorldPool)
+	{
+		SkeletalMeshComponent->SetSkeletalMesh(SkeletalMesh);
+	}
+	if (Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance)
+	{
+		SetupAnimInstance(Properties, SkeletalMeshComponent);
+	}
+	else if (UAnimationAsset* Animation = Properties->Animations.IsValidIndex(AnimIndex) ? Properties->Animations[AnimIndex].Get() : nullptr)
+	{
+		SkeletalMeshComponent->OverrideAnimationData(Animation,true,Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::PlayRate,0.0f);
+	}
+
+	if (Emitter->GetCachedEmitterData()->bLocalSpace)
+	{
+		SkeletalMeshComponent->SetAbsolute(false, false, false);
+	}
+	else
+	{
+		SkeletalMeshComponent->SetAbsolute(true, true, true);
+	}
+	return SkeletalMeshComponent;
+}
+
+int32 FNiagaraRendererSkeletal::ClampAnimIndex(const UNiagaraSkeletalRendererProperties* Properties, int32 AnimIndex)
+{
+	return FMath::Clamp(AnimIndex, 0, FMath::Max(Properties->Animations.Num() - 1, 0));
+}
+
+int32 FNiagaraRendererSkeletal::GetPoolKey(const UNiagaraSkeletalRendererProperties* Properties, int32 VisTag, int32 AnimIndex)
+{
+	if (Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance)
+	{
+		return VisTag;
+	}
+	return VisTag * FMath::Max(Properties->Animations.Num(), 1) + AnimIndex;
+}
+
+bool FNiagaraRendererSkeletal::IsComponentConfigured(const UNiagaraSkeletalRendererProperties* Properties, const USkeletalMeshComponent* Component, const USkeletalMesh* SkeletalMesh, int32 AnimIndex)
+{
+	if (Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance)
+	{
+		return Component->GetSkeletalMeshAsset() == SkeletalMesh && Cast<UNiagaraSkeletalAnimInstance>(Component->GetAnimInstance()) != nullptr;
+	}
+	const UAnimationAsset* Animation = Properties->Animations.IsValidIndex(AnimIndex) ? Properties->Animations[AnimIndex].Get() : nullptr;
+	return Component->GetSkeletalMeshAsset() == SkeletalMesh && (!Animation || Component->AnimationData.AnimToPlay == Animation);
+}
+
+void FNiagaraRendererSkeletal::SetupAnimInstance(const UNiagaraSkeletalRendererProperties* Properties, USkeletalMeshComponent* Component)
+{
+	// only reinitializes the animation when the component ran something else before
+	Component->SetAnimInstanceClass(UNiagaraSkeletalAnimInstance::StaticClass());
+	if (UNiagaraSkeletalAnimInstance* AnimInstance = Cast<UNiagaraSkeletalAnimInstance>(Component->GetAnimInstance()))
+	{
+		AnimInstance->SetAnimations(Properties->Animations, Properties->AnimationCrossfadeDuration);
+	}
+}
+
+void FNiagaraRendererSkeletal::ReconfigurePoolEntry(const UNiagaraSkeletalRendererProperties* Properties, int32 PoolIndex, USkeletalMesh* SkeletalMesh, int32 AnimIndex)
+{
+	NIAGARA_SKELETAL_SCOPE(Create);
+	FComponentPoolEntry& PoolEntry = ComponentPool[PoolIndex];
+	USkeletalMeshComponent* Component = PoolEntry.Component.Get();
+	if (Component->GetSkeletalMeshAsset() != SkeletalMesh)
+	{
+		Component->SetSkeletalMesh(SkeletalMesh);
+	}
+
+	UAnimationAsset* Animation = Properties->Animations.IsValidIndex(AnimIndex) ? Properties->Animations[AnimIndex].Get() : nullptr;
+	if (Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance)
+	{
+		// a new skeleton can get the component a fresh anim instance
+		SetupAnimInstance(Properties, Component);
+	}
+	else if (Animation && Component->AnimationData.AnimToPlay != Animation)
+	{
+		Component->OverrideAnimationData(Animation, true, Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::PlayRate, 0.0f);
+	}
+
+	// the pose, material slots and animation time all start over
+	PoolEntry.bHasAppliedState = false;
+	PoolEntry.PlayRateTracker.Reset();
+	PoolEntry.AppliedMaterialEntry = INDEX_NONE;
+}
+
+int32 FNiagaraRendererSkeletal::AddPoolEntry(USkeletalMeshComponent* SkeletalMeshComponent)
+{
+	int32 PoolIndex;
+	FComponentPoolEntry& PoolEntry = ComponentPool.AddSlot(PoolIndex);
+	PoolEntry.Component = SkeletalMeshComponent;
+	PoolEntry.LastActiveTime = SkeletalMeshComponent->GetWorld()->GetTimeSeconds();
+	return PoolIndex;
+}
+
+void FNiagaraRendererSkeletal::PrewarmComponentPool(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent)
+{
+	bPoolPrewarmed = true;
+
+	// Spread the components over every mesh and animation the particles may ask for, round robin
+	const int32 NumAnimations = Properties->AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance ? 1 : FMath::Max(Properties->Animations.Num(), 1);
+	TArray<TPair<int32, int32>, TInlineAllocator<16>> Configurations;
+	for (int32 VisTag = 0; VisTag < ResolvedMeshes.Num(); ++VisTag)
+	{
+		for (int32 AnimIndex = 0; ResolvedMeshes[VisTag] && AnimIndex < NumAnimations; ++AnimIndex)
+		{
+			Configurations.Emplace(VisTag, AnimIndex);
+		}
+	}
+	if (Configurations.Num() == 0)
+	{
+		return;
+	}
+
+	// Fill the pool up front, outside of the creation budget, so the first burst only has to pick components up
+	const int32 NumToCreate = FMath::Min<int32>(Properties->PrewarmComponentCount, Properties->ComponentCountLimit) - ComponentPool.Num();
+	for (int32 Index = 0; Index < NumToCreate; ++Index)
+	{
+		const int32 VisTag = Configurations[Index % Configurations.Num()].Key;
+		const int32 AnimIndex = Configurations[Index % Configurations.Num()].Value;
+		const int32 PoolIndex = AddPoolEntry(CreateComponent(Properties, Emitter, AttachComponent, ResolvedMeshes[VisTag], AnimIndex));
+		DeactivatePoolEntry(PoolIndex);
+		ComponentPool.SetKey(PoolIndex, GetPoolKey(Properties, VisTag, AnimIndex));
+		// without particle IDs slots are handed out in order and the free lists aren't used
+		if (Properties->bAssignComponentsOnParticleID)
+		{
+			ComponentPool.PushFree(PoolIndex);
+		}
+		++TickCounters.NumCreated;
+	}
+}
+
+void FNiagaraRendererSkeletal::ResolveSkeletalMeshes(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter)
+{
+	// The user parameter is looked up for the few bound entries only, nothing downstream changes unless the bound object does
+	ResolvedMeshes.SetNumZeroed(Properties->SkeletalMeshes.Num());
+	for (int32 MeshIndex = 0; MeshIndex < Properties->SkeletalMeshes.Num(); ++MeshIndex)
+	{
+		if (!Properties->SkeletalMeshes[MeshIndex].SkeletalMeshUserParameterBinding.Parameter.IsValid())
+		{
+			continue;
+		}
+
+		USkeletalMesh* SkeletalMesh = Properties->ResolveSkeletalMesh(Emitter, MeshIndex);
+		if (ResolvedMeshes[MeshIndex] != SkeletalMesh)
+		{
+			ResolvedMeshes[MeshIndex] = SkeletalMesh;
+			if (MeshMaterials.IsValidIndex(MeshIndex))
+			{
+				++MeshMaterials[MeshIndex].Version;
+			}
+		}
+	}
+}
+
+void FNiagaraRendererSkeletal::UpdateMeshMaterials(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter)
+{
+	for (int32 MeshIndex = 0; MeshIndex < MeshMaterials.Num(); ++MeshIndex)
+	{
+		FMeshMaterials& Materials = MeshMaterials[MeshIndex];
+		const TArray<FNiagaraMeshMaterialOverride>& OverrideMaterials = Properties->SkeletalMeshes[MeshIndex].OverrideMaterials;
+		for (int32 SlotIndex = 0; SlotIndex < Materials.BoundOverrides.Num(); ++SlotIndex)
+		{
+			const FNiagaraVariable& Parameter = OverrideMaterials[SlotIndex].UserParamBinding.Parameter;
+			if (!Parameter.IsValid())
+			{
+				continue;
+			}
+
+			// User parameter objects are kept alive by the system's parameter store, so the material can go straight into the shared array.
+			// It won't be a MID though, material parameter bindings only reach overrides that were bound when the renderer was created
+			UMaterialInterface* BoundMaterial = Cast<UMaterialInterface>(Emitter->FindBinding(Parameter));
+			const int32 MaterialIndex = Materials.FirstMaterial + SlotIndex;
+			if (BoundMaterial && BoundMaterial != Materials.BoundOverrides[SlotIndex].Get() && BaseMaterials_GT.IsValidIndex(MaterialIndex))
+			{
+				Materials.BoundOverrides[SlotIndex] = BoundMaterial;
+				BaseMaterials_GT[MaterialIndex] = BoundMaterial;
+				++Materials.Version;
+			}
+		}
+	}
+
+	// The MIDs are shared by every component, setting the values once covers all of them without touching their render state
 	if (Properties->MaterialParameters.HasAnyBindings())
 	{
 		ProcessMaterialParameterBindings(Properties->MaterialParameters, Emitter, MakeArrayView(BaseMaterials_GT));
 	}
-	
-	for(int i = 0;i<BaseMaterials_GT.Num();++i)
+}
+
+void FNiagaraRendererSkeletal::SetSkeletalMaterials(FComponentPoolEntry& PoolEntry, USkeletalMeshComponent* SkeletalMeshComponent, int32 MeshIndex)
+{
+	const FMeshMaterials& Materials = MeshMaterials[MeshIndex];
+	PoolEntry.AppliedMaterialEntry = MeshIndex;
+	PoolEntry.AppliedMaterialVersion = Materials.Version;
+	if (Materials.LayoutMesh.Get() != GetResolvedMesh(MeshIndex))
+	{
+		// the slots in BaseMaterials_GT belong to the mesh bound when the renderer was created, this one shows its own materials
+		SkeletalMeshComponent->EmptyOverrideMaterials();
+		return;
+	}
+
+	const int32 NumMaterials = FMath::Min(Materials.NumMaterials, BaseMaterials_GT.Num() - Materials.FirstMaterial);
+	for (int32 SlotIndex = 0; SlotIndex < NumMaterials; ++SlotIndex)
 	{
-		SkeletalMeshComponent->SetMaterial(i,BaseMaterials_GT[i]);
+		SkeletalMeshComponent->SetMaterial(SlotIndex, BaseMaterials_GT[Materials.FirstMaterial + SlotIndex]);
+	}
+}
+
+void FNiagaraRendererSkeletal::DeactivatePoolEntry(int32 PoolIndex)
+{
+	FComponentPoolEntry& PoolEntry = ComponentPool[PoolIndex];
+	USkeletalMeshComponent* Component = PoolEntry.Component.Get();
+	if (Component)
+	{
+		UnregisterFromBudget(Component);
+	}
+	if (Component && Component->IsActive())
+	{
+		Component->Deactivate();
+		Component->SetVisibility(false, true);
+	}
+	if (Component && PoolEntry.AppliedPoseLeader.IsValid())
+	{
+		// the next particle to use this one may want to evaluate its own pose
+		Component->SetLeaderPoseComponent(nullptr);
+	}
+	PoolEntry.AppliedPoseLeader.Reset();
+	// activating the component again turns its tick back on, so a frozen tier has to be reapplied
+	PoolEntry.AppliedAnimationLOD = INDEX_NONE;
+	PoolEntry.CulledTime = -1.0;
+	PoolEntry.bCullSuspended = false;
+	// whoever picks this entry up next has to push its full state again
+	PoolEntry.bHasAppliedState = false;
+	PoolEntry.PlayRateTracker.Reset();
+}
+
+bool FNiagaraRendererSkeletal::ReleaseComponent(USkeletalMeshComponent* Component, bool bUseWorldPool)
+{
+	UnregisterFromBudget(Component);
+	UWorld* World = Component->GetWorld();
+	UNiagaraSkeletalComponentPoolSubsystem* WorldPool = bUseWorldPool && World ? World->GetSubsystem<UNiagaraSkeletalComponentPoolSubsystem>() : nullptr;
+	if (WorldPool && WorldPool->Release(Component))
+	{
+		return false;
+	}
+	Component->DestroyComponent();
+	return true;
+}
+
+void FNiagaraRendererSkeletal::PublishReleaseCounters(const FNiagaraSkeletalTickCounters& ReleaseCounters)
+{
+	if (ReleaseCounters.NumDestroyed == 0)
+	{
+		return;
+	}
+	INC_DWORD_STAT_BY(STAT_NiagaraSkeletal_Destroyed, ReleaseCounters.NumDestroyed);
+	CSV_CUSTOM_STAT(NiagaraSkeletal, Destroyed, ReleaseCounters.NumDestroyed, ECsvCustomStatOp::Accumulate);
+	if (NiagaraSkeletalBenchmark::IsEnabled())
+	{
+		NiagaraSkeletalBenchmark::AddCounters(ReleaseCounters);
 	}
-	
 }
 
 void FNiagaraRendererSkeletal::ResetComponentPool(bool bResetOwner)
 {
+	FNiagaraSkeletalTickCounters ReleaseCounters;
 	for (FComponentPoolEntry& PoolEntry : ComponentPool)
 	{
-		if (PoolEntry.Component.IsValid())
+		if (USkeletalMeshComponent* Component = PoolEntry.Component.Get())
 		{
-			PoolEntry.Component->DestroyComponent();
+			ReleaseCounters.NumDestroyed += ReleaseComponent(Component, bUseWorldComponentPool) ? 1 : 0;
 		}
 	}
-	ComponentPool.SetNum(0, false);
+	ComponentPool.Reset();
+	bPoolPrewarmed = false;
+	ReleaseCounters.NumDestroyed += ResetInstancedMeshes();
+	PublishReleaseCounters(ReleaseCounters);
 
 	if (bResetOwner)
 	{
@@ -0,0 +1,149 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalAnimInstance.h"
+#include "Animation/AnimSequenceBase.h"
+#include "AnimationRuntime.h"
+
+namespace NiagaraSkeletalAnimInstanceLocal
+{
+	float WrapAnimTime(float AnimTime, float AnimLength)
+	{
+		if (AnimLength <= UE_SMALL_NUMBER)
+		{
+			return 0.0f;
+		}
+		const float Wrapped = FMath::Fmod(AnimTime, AnimLength);
+		return Wrapped < 0.0f ? Wrapped + AnimLength : Wrapped;
+	}
+}
+
+void UNiagaraSkeletalAnimInstance::SetAnimations(TConstArrayView<TObjectPtr<UAnimationAsset>> InAnimations, float InCrossfadeDuration)
+{
+	Animations = InAnimations;
+	CrossfadeDuration = FMath::Max(InCrossfadeDuration, 0.0f);
+	bAnimationsDirty = true;
+	bSnapPending = true;
+}
+
+void UNiagaraSkeletalAnimInstance::SetParticleState(const FNiagaraSkeletalAnimState& InState, bool bSnap)
+{
+	State = InState;
+	bSnapPending |= bSnap;
+}
+
+FAnimInstanceProxy* UNiagaraSkeletalAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FNiagaraSkeletalAnimInstanceProxy(this);
+}
+
+void FNiagaraSkeletalAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	UNiagaraSkeletalAnimInstance* AnimInstance = CastChecked<UNiagaraSkeletalAnimInstance>(InAnimInstance);
+	if (AnimInstance->bAnimationsDirty)
+	{
+		Animations.Reset(AnimInstance->Animations.Num());
+		for (UAnimationAsset* Animation : AnimInstance->Animations)
+		{
+			Animations.Add(Animation);
+		}
+		CrossfadeDuration = AnimInstance->CrossfadeDuration;
+		AnimInstance->bAnimationsDirty = false;
+	}
+	State = AnimInstance->State;
+	bSnap = AnimInstance->bSnapPending;
+	AnimInstance->bSnapPending = false;
+}
+
+void FNiagaraSkeletalAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	if (bSnap || Current.AnimIndex == INDEX_NONE)
+	{
+		Previous.AnimIndex = INDEX_NONE;
+		CrossfadeAlpha = 1.0f;
+	}
+	else if (State.AnimIndex != Current.AnimIndex && CrossfadeDuration > 0.0f)
+	{
+		// Going back to the animation that is fading out reverses the fade, switching to a third one drops the oldest
+		const bool bReverse = Previous.AnimIndex == State.AnimIndex;
+		Swap(Previous, Current);
+		CrossfadeAlpha = bReverse ? 1.0f - CrossfadeAlpha : 0.0f;
+	}
+
+	if (State.AnimIndex != Current.AnimIndex)
+	{
+		Current.AnimIndex = State.AnimIndex;
+		Current.BlendSamples.Reset();
+		Current.CachedTriangulationIndex = INDEX_NONE;
+	}
+	Current.AnimTime = State.AnimTime;
+	Current.BlendParameters = State.BlendParameters;
+
+	if (Previous.AnimIndex != INDEX_NONE)
+	{
+		// the particle no longer drives the animation fading out, it carries on at its own pace
+		Previous.AnimTime += DeltaSeconds;
+		CrossfadeAlpha = FMath::Min(CrossfadeAlpha + DeltaSeconds / CrossfadeDuration, 1.0f);
+		if (CrossfadeAlpha >= 1.0f)
+		{
+			Previous.AnimIndex = INDEX_NONE;
+		}
+	}
+}
+
+bool FNiagaraSkeletalAnimInstanceProxy::Evaluate(FPoseContext& Output)
+{
+	if (Previous.AnimIndex == INDEX_NONE)
+	{
+		EvaluatePlayer(Current, Output);
+		return true;
+	}
+
+	FPoseContext FromPose(Output);
+	FPoseContext ToPose(Output);
+	EvaluatePlayer(Previous, FromPose);
+	EvaluatePlayer(Current, ToPose);
+
+	const FAnimationPoseData FromPoseData(FromPose);
+	const FAnimationPoseData ToPoseData(ToPose);
+	FAnimationPoseData OutPoseData(Output);
+	FAnimationRuntime::BlendTwoPosesTogether(ToPoseData, FromPoseData, CrossfadeAlpha, OutPoseData);
+	return true;
+}
+
+void FNiagaraSkeletalAnimInstanceProxy::EvaluatePlayer(FPlayer& Player, FPoseContext& Output)
+{
+	using namespace NiagaraSkeletalAnimInstanceLocal;
+
+	UAnimationAsset* Animation = Animations.IsValidIndex(Player.AnimIndex) ? Animations[Player.AnimIndex] : nullptr;
+	FAnimationPoseData PoseData(Output);
+	if (const UAnimSequenceBase* Sequence = Cast<UAnimSequenceBase>(Animation))
+	{
+		Sequence->GetAnimationPose(PoseData, FAnimExtractContext(double(WrapAnimTime(Player.AnimTime, Sequence->GetPlayLength()))));
+		return;
+	}
+
+	const UBlendSpace* BlendSpace = Cast<UBlendSpace>(Animation);
+	const FVector BlendInput(Player.BlendParameters.X, Player.BlendParameters.Y, 0.0f);
+	if (BlendSpace && BlendSpace->GetSamplesFromBlendInput(BlendInput, Player.BlendSamples, Player.CachedTriangulationIndex, false))
+	{
+		// Samples play in sync, the particle's time runs over their weighted length and every sample is at the same fraction of its own
+		float BlendLength = 0.0f;
+		for (const FBlendSampleData& Sample : Player.BlendSamples)
+		{
+			BlendLength += Sample.Animation ? Sample.GetClampedWeight() * Sample.Animation->GetPlayLength() : 0.0f;
+		}
+		const float Phase = BlendLength > UE_SMALL_NUMBER ? WrapAnimTime(Player.AnimTime, BlendLength) / BlendLength : 0.0f;
+		for (FBlendSampleData& Sample : Player.BlendSamples)
+		{
+			Sample.Time = Sample.Animation ? Phase * Sample.Animation->GetPlayLength() : 0.0f;
+		}
+		BlendSpace->GetAnimationPose(Player.BlendSamples, FAnimExtractContext(double(Phase * BlendLength)), PoseData);
+		return;
+	}
+
+	Output.ResetToRefPose();
+}
@@ -0,0 +1,203 @@
+﻿#include "NiagaraSkeletalBenchmark.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonWriter.h"
+#include <atomic>
+
+static int32 GNiagaraSkeletalBenchmark = 0;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalBenchmark(
+	TEXT("fx.Niagara.Skeletal.Benchmark"),
+	GNiagaraSkeletalBenchmark,
+	TEXT("When enabled skeletal renderers record their phase timings and pool counters until fx.Niagara.Skeletal.Benchmark.Dump is run."),
+	ECVF_Default
+);
+
+static FAutoConsoleCommand CmdNiagaraSkeletalBenchmarkReset(
+	TEXT("fx.Niagara.Skeletal.Benchmark.Reset"),
+	TEXT("Clears everything the skeletal renderers recorded for the benchmark so far."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		NiagaraSkeletalBenchmark::Reset();
+	})
+);
+
+static FAutoConsoleCommand CmdNiagaraSkeletalBenchmarkDump(
+	TEXT("fx.Niagara.Skeletal.Benchmark.Dump"),
+	TEXT("Writes what the skeletal renderers recorded for the benchmark as JSON, to the file given as argument or the log."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Json = NiagaraSkeletalBenchmark::ToJson();
+		if (Args.Num() > 0)
+		{
+			if (!FFileHelper::SaveStringToFile(Json, *Args[0]))
+			{
+				GLog->Logf(ELogVerbosity::Error, TEXT("Failed to write the skeletal renderer benchmark to %s"), *Args[0]);
+			}
+		}
+		else
+		{
+			GLog->Log(Json);
+		}
+	})
+);
+
+namespace NiagaraSkeletalBenchmark
+{
+	struct FPhaseTimes
+	{
+		std::atomic<uint64> NumCalls{ 0 };
+		std::atomic<uint64> TotalCycles{ 0 };
+		std::atomic<uint64> MaxCycles{ 0 };
+	};
+
+	struct FRecording
+	{
+		FPhaseTimes Phases[int32(EPhase::Num)];
+
+		// game thread only
+		int64 NumTicks = 0;
+		int64 NumParticles = 0;
+		int32 PeakParticles = 0;
+		int32 PeakLiveComponents = 0;
+		int32 PeakPoolSize = 0;
+		int64 NumTicksWithGrowth = 0;
+		int64 ContainerGrowth = 0;
+		FNiagaraSkeletalTickCounters Totals;
+	};
+
+	static FRecording GRecording;
+
+	static const TCHAR* GetPhaseName(EPhase Phase)
+	{
+		static const TCHAR* Names[] =
+		{
+			TEXT("PostSystemTick"),
+			TEXT("Extract"),
+			TEXT("Reconcile"),
+			TEXT("Cull"),
+			TEXT("Prioritize"),
+			TEXT("Assign"),
+			TEXT("Create"),
+			TEXT("ComputeUpdates"),
+			TEXT("Apply"),
+			TEXT("Cleanup"),
+			TEXT("InstancedMeshes"),
+		};
+		static_assert(UE_ARRAY_COUNT(Names) == int32(EPhase::Num), "Every phase needs a name");
+		return Names[int32(Phase)];
+	}
+
+	bool IsEnabled()
+	{
+		return GNiagaraSkeletalBenchmark != 0;
+	}
+
+	void Reset()
+	{
+		check(IsInGameThread());
+		for (FPhaseTimes& PhaseTimes : GRecording.Phases)
+		{
+			PhaseTimes.NumCalls = 0;
+			PhaseTimes.TotalCycles = 0;
+			PhaseTimes.MaxCycles = 0;
+		}
+		GRecording.NumTicks = 0;
+		GRecording.NumParticles = 0;
+		GRecording.PeakParticles = 0;
+		GRecording.PeakLiveComponents = 0;
+		GRecording.PeakPoolSize = 0;
+		GRecording.NumTicksWithGrowth = 0;
+		GRecording.ContainerGrowth = 0;
+		GRecording.Totals = FNiagaraSkeletalTickCounters();
+	}
+
+	void AddPhaseTime(EPhase Phase, uint64 Cycles)
+	{
+		FPhaseTimes& PhaseTimes = GRecording.Phases[int32(Phase)];
+		PhaseTimes.NumCalls.fetch_add(1, std::memory_order_relaxed);
+		PhaseTimes.TotalCycles.fetch_add(Cycles, std::memory_order_relaxed);
+		uint64 MaxCycles = PhaseTimes.MaxCycles.load(std::memory_order_relaxed);
+		while (Cycles > MaxCycles && !PhaseTimes.MaxCycles.compare_exchange_weak(MaxCycles, Cycles, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void AddTick(const FNiagaraSkeletalTickCounters& Counters, int32 NumParticles, int32 NumLiveComponents, int32 PoolSize, int64 ContainerGrowth)
+	{
+		check(IsInGameThread());
+		++GRecording.NumTicks;
+		GRecording.NumParticles += NumParticles;
+		GRecording.PeakParticles = FMath::Max(GRecording.PeakParticles, NumParticles);
+		GRecording.PeakLiveComponents = FMath::Max(GRecording.PeakLiveComponents, NumLiveComponents);
+		GRecording.PeakPoolSize = FMath::Max(GRecording.PeakPoolSize, PoolSize);
+		if (ContainerGrowth > 0)
+		{
+			++GRecording.NumTicksWithGrowth;
+			GRecording.ContainerGrowth += ContainerGrowth;
+		}
+		AddCounters(Counters);
+	}
+
+	void AddCounters(const FNiagaraSkeletalTickCounters& Counters)
+	{
+		check(IsInGameThread());
+		FNiagaraSkeletalTickCounters& Totals = GRecording.Totals;
+		Totals.NumPoolHits += Counters.NumPoolHits;
+		Totals.NumPoolMisses += Counters.NumPoolMisses;
+		Totals.NumCreated += Counters.NumCreated;
+		Totals.NumReconfigured += Counters.NumReconfigured;
+		Totals.NumDestroyed += Counters.NumDestroyed;
+		Totals.NumDropped += Counters.NumDropped;
+		Totals.NumPending += Counters.NumPending;
+	}
+
+	FString ToJson()
+	{
+		check(IsInGameThread());
+		FString Json;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("ticks"), GRecording.NumTicks);
+		Writer->WriteValue(TEXT("meanParticles"), GRecording.NumTicks > 0 ? double(GRecording.NumParticles) / double(GRecording.NumTicks) : 0.0);
+		Writer->WriteValue(TEXT("peakParticles"), GRecording.PeakParticles);
+
+		// times are per renderer tick, a phase that didn't run on a tick doesn't count towards its mean
+		Writer->WriteObjectStart(TEXT("phases"));
+		for (int32 PhaseIndex = 0; PhaseIndex < int32(EPhase::Num); ++PhaseIndex)
+		{
+			const FPhaseTimes& PhaseTimes = GRecording.Phases[PhaseIndex];
+			const uint64 NumCalls = PhaseTimes.NumCalls.load();
+			const double TotalMs = FPlatformTime::ToMilliseconds64(PhaseTimes.TotalCycles.load());
+			Writer->WriteObjectStart(GetPhaseName(EPhase(PhaseIndex)));
+			Writer->WriteValue(TEXT("calls"), int64(NumCalls));
+			Writer->WriteValue(TEXT("totalMs"), TotalMs);
+			Writer->WriteValue(TEXT("meanMs"), NumCalls > 0 ? TotalMs / double(NumCalls) : 0.0);
+			Writer->WriteValue(TEXT("maxMs"), FPlatformTime::ToMilliseconds64(PhaseTimes.MaxCycles.load()));
+			Writer->WriteObjectEnd();
+		}
+		Writer->WriteObjectEnd();
+
+		const FNiagaraSkeletalTickCounters& Totals = GRecording.Totals;
+		Writer->WriteObjectStart(TEXT("components"));
+		Writer->WriteValue(TEXT("created"), Totals.NumCreated);
+		Writer->WriteValue(TEXT("reconfigured"), Totals.NumReconfigured);
+		Writer->WriteValue(TEXT("destroyed"), Totals.NumDestroyed);
+		Writer->WriteValue(TEXT("poolHits"), Totals.NumPoolHits);
+		Writer->WriteValue(TEXT("poolMisses"), Totals.NumPoolMisses);
+		Writer->WriteValue(TEXT("droppedParticles"), Totals.NumDropped);
+		Writer->WriteValue(TEXT("pendingParticles"), Totals.NumPending);
+		Writer->WriteValue(TEXT("peakLive"), GRecording.PeakLiveComponents);
+		Writer->WriteValue(TEXT("peakPoolSize"), GRecording.PeakPoolSize);
+		Writer->WriteObjectEnd();
+
+		// only what the renderer's own arrays grew by, allocations made by the engine on its behalf aren't in here
+		Writer->WriteObjectStart(TEXT("containerGrowth"));
+		Writer->WriteValue(TEXT("ticks"), GRecording.NumTicksWithGrowth);
+		Writer->WriteValue(TEXT("bytes"), GRecording.ContainerGrowth);
+		Writer->WriteObjectEnd();
+
+		Writer->WriteObjectEnd();
+		Writer->Close();
+		return Json;
+	}
+}
@@ -0,0 +1,62 @@
+﻿#include "NiagaraSkeletalBoundsCalculator.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "NiagaraSkeletalRendererProperties.h"
+
+FNiagaraSkeletalBoundsCalculator::FNiagaraSkeletalBoundsCalculator(const UNiagaraSkeletalRendererProperties* Properties)
+{
+	PositionName = Properties->PositionBinding.GetDataSetBindableVariable().GetName();
+	ScaleName = Properties->ScaleBinding.GetDataSetBindableVariable().GetName();
+
+	// Particles can face any direction, so meshes are treated as spheres around the particle position.
+	// Meshes bound through user parameters are only known at runtime and aren't included
+	for (const FNiagaraSkeletalReference& Entry : Properties->SkeletalMeshes)
+	{
+		if (Entry.SkeletalMesh)
+		{
+			const FBoxSphereBounds MeshBounds = Entry.SkeletalMesh->GetBounds();
+			MaxMeshRadius = FMath::Max(MaxMeshRadius, float(MeshBounds.Origin.Size() + MeshBounds.SphereRadius));
+		}
+	}
+
+	// baked meshes carry bounds extended over every baked frame
+	if (Properties->RenderMode != ENiagaraSkeletalRenderMode::Components)
+	{
+		for (const FNiagaraSkeletalVertexAnimationBake& Bake : Properties->VertexAnimationBakes)
+		{
+			if (Bake.StaticMesh)
+			{
+				const FBoxSphereBounds MeshBounds = Bake.StaticMesh->GetBounds();
+				MaxMeshRadius = FMath::Max(MaxMeshRadius, float(MeshBounds.Origin.Size() + MeshBounds.SphereRadius));
+			}
+		}
+	}
+}
+
+void FNiagaraSkeletalBoundsCalculator::InitAccessors(const FNiagaraDataSetCompiledData* CompiledData)
+{
+	PositionAccessor.Init(CompiledData, PositionName);
+	ScaleAccessor.Init(CompiledData, ScaleName);
+}
+
+FBox FNiagaraSkeletalBoundsCalculator::CalculateBounds(const FTransform& SystemTransform, const FNiagaraDataSet& DataSet, const int32 NumInstances) const
+{
+	if (NumInstances == 0 || !PositionAccessor.IsValid())
+	{
+		return FBox(ForceInit);
+	}
+
+	FNiagaraPosition MinPosition, MaxPosition;
+	PositionAccessor.GetReader(DataSet).GetMinMax(MinPosition, MaxPosition);
+
+	float MaxScale = 1.0f;
+	if (ScaleAccessor.IsValid())
+	{
+		FVector3f MinScaleAxes, MaxScaleAxes;
+		ScaleAccessor.GetReader(DataSet).GetMinMax(MinScaleAxes, MaxScaleAxes);
+		MaxScale = FMath::Max(MinScaleAxes.GetAbsMax(), MaxScaleAxes.GetAbsMax());
+	}
+
+	const FVector Extent(MaxMeshRadius * MaxScale);
+	return FBox(FVector(MinPosition) - Extent, FVector(MaxPosition) + Extent);
+}
@@ -0,0 +1,220 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalComponentPoolSubsystem.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Misc/CoreDelegates.h"
+
+static int32 GNiagaraSkeletalWorldPoolEnabled = 1;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalWorldPoolEnabled(
+	TEXT("fx.Niagara.Skeletal.WorldPool.Enabled"),
+	GNiagaraSkeletalWorldPoolEnabled,
+	TEXT("When enabled skeletal renderers that opt in with Use World Component Pool park their components in a per world pool instead of destroying them."),
+	ECVF_Default
+);
+
+static int32 GNiagaraSkeletalWorldPoolMaxPerMesh = 64;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalWorldPoolMaxPerMesh(
+	TEXT("fx.Niagara.Skeletal.WorldPool.MaxPerMesh"),
+	GNiagaraSkeletalWorldPoolMaxPerMesh,
+	TEXT("Maximum number of components parked per skeletal mesh and component class in each world, components released past this are destroyed."),
+	ECVF_Default
+);
+
+static float GNiagaraSkeletalWorldPoolIdleTimeout = 30.0f;
+static FAutoConsoleVariableRef CVarNiagaraSkeletalWorldPoolIdleTimeout(
+	TEXT("fx.Niagara.Skeletal.WorldPool.IdleTimeout"),
+	GNiagaraSkeletalWorldPoolIdleTimeout,
+	TEXT("Seconds a component can stay parked in the world pool before it is destroyed. 0 keeps parked components until the world is cleaned up."),
+	ECVF_Default
+);
+
+static FAutoConsoleCommandWithWorld CmdNiagaraSkeletalWorldPoolDump(
+	TEXT("fx.Niagara.Skeletal.WorldPool.Dump"),
+	TEXT("Logs the skeletal renderer component pool statistics for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UNiagaraSkeletalComponentPoolSubsystem* Subsystem = World ? World->GetSubsystem<UNiagaraSkeletalComponentPoolSubsystem>() : nullptr)
+		{
+			Subsystem->DumpStats(*GLog);
+		}
+	})
+);
+
+bool UNiagaraSkeletalComponentPoolSubsystem::IsEnabled()
+{
+	return GNiagaraSkeletalWorldPoolEnabled != 0;
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	// parked components are only a cache, they're the first thing to go when the platform asks for memory back
+	MemoryTrimHandle = FCoreDelegates::GetMemoryTrimDelegate().AddUObject(this, &UNiagaraSkeletalComponentPoolSubsystem::Empty);
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::Deinitialize()
+{
+	FCoreDelegates::GetMemoryTrimDelegate().Remove(MemoryTrimHandle);
+	Empty();
+	Super::Deinitialize();
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (Stats.NumParked > 0 && GNiagaraSkeletalWorldPoolIdleTimeout > 0.0f)
+	{
+		DestroyExpired(GetWorld()->GetRealTimeSeconds() - GNiagaraSkeletalWorldPoolIdleTimeout);
+	}
+}
+
+TStatId UNiagaraSkeletalComponentPoolSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UNiagaraSkeletalComponentPoolSubsystem, STATGROUP_Tickables);
+}
+
+USkeletalMeshComponent* UNiagaraSkeletalComponentPoolSubsystem::Acquire(USkeletalMesh* SkeletalMesh, UClass* ComponentClass, AActor* NewOwner)
+{
+	FNiagaraSkeletalParkedComponents* Parked = ParkedComponents.Find(FNiagaraSkeletalParkedKey{ SkeletalMesh, ComponentClass });
+	while (Parked && Parked->Components.Num() > 0)
+	{
+		USkeletalMeshComponent* Component = Parked->Components.Pop(false);
+		Parked->ParkedTimes.Pop(false);
+		--Stats.NumParked;
+		if (IsValid(Component))
+		{
+			++Stats.NumHits;
+			Component->Rename(nullptr, NewOwner, REN_DontCreateRedirectors | REN_ForceNoResetLoaders | REN_NonTransactional);
+			return Component;
+		}
+	}
+
+	++Stats.NumMisses;
+	return nullptr;
+}
+
+bool UNiagaraSkeletalComponentPoolSubsystem::Release(USkeletalMeshComponent* Component)
+{
+	UWorld* World = GetWorld();
+	USkeletalMesh* SkeletalMesh = Component ? Component->GetSkeletalMeshAsset() : nullptr;
+	if (!IsEnabled() || !World || World->bIsTearingDown || !IsValid(Component) || !SkeletalMesh)
+	{
+		return false;
+	}
+
+	FNiagaraSkeletalParkedComponents& Parked = ParkedComponents.FindOrAdd(FNiagaraSkeletalParkedKey{ SkeletalMesh, Component->GetClass() });
+	if (Parked.Components.Num() >= GNiagaraSkeletalWorldPoolMaxPerMesh)
+	{
+		++Stats.NumDiscarded;
+		return false;
+	}
+
+	AActor* Owner = GetParkingOwner();
+	if (!Owner)
+	{
+		return false;
+	}
+
+	// Parked components keep their mesh and anim instance, but don't tick, render or stay attached to their old system
+	if (USceneComponent* AttachParent = Component->GetAttachParent())
+	{
+		Component->RemoveTickPrerequisiteComponent(AttachParent);
+	}
+	Component->SetLeaderPoseComponent(nullptr);
+	// whoever acquires it next may not use animation LODs at all
+	Component->EnableExternalTickRateControl(false);
+	Component->SetComponentTickEnabled(true);
+	Component->SetForcedLOD(0);
+	// nor the materials and custom data the last system gave them
+	Component->EmptyOverrideMaterials();
+	Component->ResetCustomPrimitiveData();
+	Component->Deactivate();
+	Component->DetachFromComponent(FDetachmentTransformRules::KeepRelativeTransform);
+	Component->UnregisterComponent();
+	Component->Rename(nullptr, Owner, REN_DontCreateRedirectors | REN_ForceNoResetLoaders | REN_NonTransactional);
+
+	Parked.Components.Add(Component);
+	Parked.ParkedTimes.Add(World->GetRealTimeSeconds());
+	++Stats.NumParked;
+	++Stats.NumReleased;
+	return true;
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::Empty()
+{
+	for (TPair<FNiagaraSkeletalParkedKey, FNiagaraSkeletalParkedComponents>& Pair : ParkedComponents)
+	{
+		for (USkeletalMeshComponent* Component : Pair.Value.Components)
+		{
+			if (IsValid(Component))
+			{
+				Component->DestroyComponent();
+			}
+		}
+	}
+	ParkedComponents.Empty();
+	Stats.NumParked = 0;
+
+	if (IsValid(ParkingOwner))
+	{
+		ParkingOwner->Destroy();
+	}
+	ParkingOwner = nullptr;
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::DestroyExpired(double ParkedBefore)
+{
+	for (auto It = ParkedComponents.CreateIterator(); It; ++It)
+	{
+		FNiagaraSkeletalParkedComponents& Parked = It.Value();
+		int32 NumExpired = 0;
+		while (NumExpired < Parked.ParkedTimes.Num() && Parked.ParkedTimes[NumExpired] < ParkedBefore)
+		{
+			USkeletalMeshComponent* Component = Parked.Components[NumExpired];
+			if (IsValid(Component))
+			{
+				Component->DestroyComponent();
+			}
+			++NumExpired;
+		}
+		if (NumExpired == 0)
+		{
+			continue;
+		}
+
+		Stats.NumParked -= NumExpired;
+		Stats.NumExpired += NumExpired;
+		if (NumExpired == Parked.Components.Num())
+		{
+			// nothing left to hand out, and the key would keep the mesh loaded
+			It.RemoveCurrent();
+			continue;
+		}
+		Parked.Components.RemoveAt(0, NumExpired, false);
+		Parked.ParkedTimes.RemoveAt(0, NumExpired, false);
+	}
+}
+
+void UNiagaraSkeletalComponentPoolSubsystem::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("Niagara skeletal component pool for %s: %d parked, %d hits, %d misses, %d released, %d discarded, %d expired"),
+		*GetNameSafe(GetWorld()), Stats.NumParked, Stats.NumHits, Stats.NumMisses, Stats.NumReleased, Stats.NumDiscarded, Stats.NumExpired);
+	for (const TPair<FNiagaraSkeletalParkedKey, FNiagaraSkeletalParkedComponents>& Pair : ParkedComponents)
+	{
+		Ar.Logf(TEXT("  %s (%s): %d parked"), *GetNameSafe(Pair.Key.SkeletalMesh), *GetNameSafe(Pair.Key.ComponentClass), Pair.Value.Components.Num());
+	}
+}
+
+AActor* UNiagaraSkeletalComponentPoolSubsystem::GetParkingOwner()
+{
+	if (!IsValid(ParkingOwner))
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		ParkingOwner = GetWorld()->SpawnActor<AActor>(SpawnParams);
+	}
+	return ParkingOwner;
+}
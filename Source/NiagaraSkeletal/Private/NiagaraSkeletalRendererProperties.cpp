@@ -9,6 +9,7 @@
 #include "NiagaraEmitterInstance.h"
 #include "NiagaraMeshRendererProperties.h"
 #include "NiagaraModule.h"
+#include "NiagaraSkeletalBoundsCalculator.h"
 #include "Styling/SlateIconFinder.h"
 
 
@@ -17,6 +18,8 @@ FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_Age;
 FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_Rotate;
 FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_AnimIndex;
 FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_Enabled;
+FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_Priority;
+FNiagaraVariable UNiagaraSkeletalRendererProperties::Particles_AnimBlendParameters;
 TArray<TWeakObjectPtr<UNiagaraSkeletalRendererProperties>> UNiagaraSkeletalRendererProperties::SkeletalRendererPropertiesToDeferredInit;
 
 #define LOCTEXT_NAMESPACE "UNiagaraSkeletalRendererProperties"
@@ -30,7 +33,7 @@ FNiagaraSkeletalReference::FNiagaraSkeletalReference()
 
 UNiagaraSkeletalRendererProperties::UNiagaraSkeletalRendererProperties()
 {
-	AttributeBindings.Reserve(7);
+	AttributeBindings.Reserve(9);
 	AttributeBindings.Add(&PositionBinding);
 	AttributeBindings.Add(&RotationBinding);
 	AttributeBindings.Add(&ScaleBinding);
@@ -38,6 +41,8 @@ UNiagaraSkeletalRendererProperties::UNiagaraSkeletalRendererProperties()
 	AttributeBindings.Add(&AnimIndexBinding);
 	AttributeBindings.Add(&RendererVisibilityTagBinding);
 	AttributeBindings.Add(&EnabledBinding);
+	AttributeBindings.Add(&PriorityBinding);
+	AttributeBindings.Add(&AnimBlendParametersBinding);
 	if(SkeletalMeshes.Num() == 0)
 	{
 		SkeletalMeshes.AddDefaulted();
@@ -59,6 +64,28 @@ void UNiagaraSkeletalRendererProperties::PostInitProperties()
 	InitBindings();
 }
 
+#if WITH_EDITOR
+void UNiagaraSkeletalRendererProperties::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (RenderMode != ENiagaraSkeletalRenderMode::Components)
+	{
+		BakeVertexAnimations();
+	}
+}
+
+void UNiagaraSkeletalRendererProperties::BakeVertexAnimations()
+{
+	VertexAnimationBakes.SetNum(SkeletalMeshes.Num());
+	for (int32 Index = 0; Index < SkeletalMeshes.Num(); ++Index)
+	{
+		// user parameter bound meshes are only known at runtime, they can't be baked
+		NiagaraSkeletalVertexAnimation::BakeAssets(this, SkeletalMeshes[Index].SkeletalMesh, Animations, VertexAnimationFrameRate, RenderMode == ENiagaraSkeletalRenderMode::InstancedSkinned, VertexAnimationBakes[Index]);
+	}
+}
+#endif
+
 void UNiagaraSkeletalRendererProperties::InitCDOPropertiesAfterModuleStartup()
 {
 	InitDefaultAttributes();
@@ -83,13 +110,38 @@ FNiagaraRenderer* UNiagaraSkeletalRendererProperties::CreateEmitterRenderer(ERHI
 	return NewRenderer;
 }
 
+FNiagaraBoundsCalculator* UNiagaraSkeletalRendererProperties::CreateBoundsCalculator()
+{
+	return new FNiagaraSkeletalBoundsCalculator(this);
+}
+
+USkeletalMesh* UNiagaraSkeletalRendererProperties::ResolveSkeletalMesh(const FNiagaraEmitterInstance* Emitter, int32 MeshIndex) const
+{
+	const FNiagaraSkeletalReference& Entry = SkeletalMeshes[MeshIndex];
+	if (Emitter && Entry.SkeletalMeshUserParameterBinding.Parameter.IsValid())
+	{
+		if (USkeletalMesh* BoundMesh = Cast<USkeletalMesh>(Emitter->FindBinding(Entry.SkeletalMeshUserParameterBinding.Parameter)))
+		{
+			return BoundMesh;
+		}
+	}
+	return Entry.SkeletalMesh;
+}
+
 void UNiagaraSkeletalRendererProperties::GetUsedMaterials(const FNiagaraEmitterInstance* InEmitter, TArray<UMaterialInterface*>& OutMaterials) const
 {
-	for (const FNiagaraSkeletalReference& Entry : SkeletalMeshes)
+	if (RenderMode != ENiagaraSkeletalRenderMode::Components && VertexAnimationMaterial)
+	{
+		OutMaterials.Add(VertexAnimationMaterial);
+		return;
+	}
+
+	for (int32 MeshIndex = 0; MeshIndex < SkeletalMeshes.Num(); ++MeshIndex)
 	{
-		if (Entry.SkeletalMesh)
+		const FNiagaraSkeletalReference& Entry = SkeletalMeshes[MeshIndex];
+		if (USkeletalMesh* SkeletalMesh = ResolveSkeletalMesh(InEmitter, MeshIndex))
 		{
-			TArray<FSkeletalMaterial> &SkeletalMaterials = Entry.SkeletalMesh->GetMaterials();
+			TArray<FSkeletalMaterial> &SkeletalMaterials = SkeletalMesh->GetMaterials();
 			const int32 MaxIndex = FMath::Max(SkeletalMaterials.Num(), Entry.OverrideMaterials.Num());
 			OutMaterials.Reserve(MaxIndex);
 			for (int i = 0; i < MaxIndex; i++)
@@ -153,12 +205,39 @@ void UNiagaraSkeletalRendererProperties::CacheFromCompiledData(const FNiagaraDat
 	Super::CacheFromCompiledData(CompiledData);
 	InitParticleDataSetAccessor(PositionAccessor,CompiledData,PositionBinding);
 	InitParticleDataSetAccessor(RotateAccessor,CompiledData,RotationBinding);
-	InitParticleDataSetAccessor(ScaleAccessor,CompiledData,PositionBinding);
+	InitParticleDataSetAccessor(ScaleAccessor,CompiledData,ScaleBinding);
 	InitParticleDataSetAccessor(AnimTimeAccessor,CompiledData,AnimTimeBinding);
 	InitParticleDataSetAccessor(VisTagAccessor,CompiledData,RendererVisibilityTagBinding);
 	InitParticleDataSetAccessor(AnimIndexAccessor,CompiledData,AnimIndexBinding);
 	InitParticleDataSetAccessor(EnabledAccessor,CompiledData,EnabledBinding);
+	InitParticleDataSetAccessor(PriorityAccessor,CompiledData,PriorityBinding);
+	InitParticleDataSetAccessor(AnimBlendParametersAccessor,CompiledData,AnimBlendParametersBinding);
 	UniqueIDAccessor.Init(CompiledData, FName("UniqueID"));
+
+	// Custom data is copied as raw float components, bindings to missing or non float attributes are dropped
+	CustomDataLayouts.Reset();
+	NumCustomDataFloats = 0;
+	for (const FNiagaraSkeletalCustomDataBinding& CustomDataBinding : CustomDataBindings)
+	{
+		const int32 VariableIndex = CompiledData ? CompiledData->Variables.IndexOfByKey(CustomDataBinding.Binding.GetDataSetBindableVariable()) : INDEX_NONE;
+		if (VariableIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FNiagaraVariableLayoutInfo& Layout = CompiledData->VariableLayouts[VariableIndex];
+		if (Layout.GetNumFloatComponents() == 0)
+		{
+			continue;
+		}
+
+		FNiagaraSkeletalCustomDataLayout& CustomDataLayout = CustomDataLayouts.AddDefaulted_GetRef();
+		CustomDataLayout.FloatComponentStart = Layout.GetFloatComponentStart();
+		CustomDataLayout.NumFloats = Layout.GetNumFloatComponents();
+		CustomDataLayout.CustomDataIndex = FMath::Max(CustomDataBinding.CustomDataIndex, 0);
+		CustomDataLayout.PackedOffset = NumCustomDataFloats;
+		NumCustomDataFloats += CustomDataLayout.NumFloats;
+	}
 }
 
 
@@ -244,6 +323,8 @@ const TArray<FNiagaraVariable>& UNiagaraSkeletalRendererProperties::GetOptionalA
 		Attrs.Add(Particles_Rotate);
 		Attrs.Add(Particles_AnimIndex);
 		Attrs.Add(Particles_Enabled);
+		Attrs.Add(Particles_Priority);
+		Attrs.Add(Particles_AnimBlendParameters);
 	}
 	return Attrs;
 }
@@ -285,6 +366,14 @@ void UNiagaraSkeletalRendererProperties::InitBindings()
 		AnimIndexBinding = CreateDefaultBinding(Particles_AnimIndex,0);
 		EnabledBinding = CreateDefaultBinding(Particles_Enabled,true);
 	}
+	if(!PriorityBinding.IsValid())
+	{
+		PriorityBinding = CreateDefaultBinding(Particles_Priority,1.0f);
+	}
+	if(!AnimBlendParametersBinding.IsValid())
+	{
+		AnimBlendParametersBinding = CreateDefaultBinding(Particles_AnimBlendParameters,FVector2f::ZeroVector);
+	}
 }
 
 void UNiagaraSkeletalRendererProperties::InitDefaultAttributes()
@@ -305,4 +394,12 @@ void UNiagaraSkeletalRendererProperties::InitDefaultAttributes()
 	{
 		Particles_Enabled = FNiagaraVariable(FNiagaraTypeDefinition::GetBoolDef(),TEXT("Particles.Visibility"));
 	}
+	if(!Particles_Priority.IsValid())
+	{
+		Particles_Priority = FNiagaraVariable(FNiagaraTypeDefinition::GetFloatDef(),TEXT("Particles.SkeletalPriority"));
+	}
+	if(!Particles_AnimBlendParameters.IsValid())
+	{
+		Particles_AnimBlendParameters = FNiagaraVariable(FNiagaraTypeDefinition::GetVec2Def(),TEXT("Particles.AnimBlendParameters"));
+	}
 }
@@ -0,0 +1,304 @@
+﻿#include "NiagaraSkeletalSlotTable.h"
+
+void FNiagaraSkeletalSlotTable::Reserve(int32 NumSlots)
+{
+	Slots.Reserve(NumSlots);
+	const int32 NumBuckets = FMath::Max(16, (int32)FMath::RoundUpToPowerOfTwo(uint32(NumSlots) * 2));
+	if (NumBuckets > Buckets.Num())
+	{
+		Rehash(NumBuckets);
+	}
+}
+
+void FNiagaraSkeletalSlotTable::Reset()
+{
+	Slots.Reset();
+	for (FBucket& Bucket : Buckets)
+	{
+		Bucket = FBucket();
+	}
+	FreeHeads.Reset();
+	NumFreeSlots = 0;
+	NumAssignedSlots = 0;
+}
+
+int32 FNiagaraSkeletalSlotTable::AddSlot()
+{
+	// Only grow the map when the pool grows, steady state ticks never get here
+	if (Slots.Num() * 2 >= Buckets.Num())
+	{
+		Rehash(FMath::Max(16, (int32)FMath::RoundUpToPowerOfTwo(uint32(Slots.Num() + 1) * 2)));
+	}
+	return Slots.AddDefaulted();
+}
+
+void FNiagaraSkeletalSlotTable::RemoveSlotSwap(int32 SlotIndex, bool bRebuildFreeList)
+{
+	check(Slots.IsValidIndex(SlotIndex));
+	if (Slots[SlotIndex].bAssigned)
+	{
+		RemoveBucket(Slots[SlotIndex].ParticleID);
+		--NumAssignedSlots;
+	}
+
+	const int32 LastIndex = Slots.Num() - 1;
+	if (SlotIndex != LastIndex && Slots[LastIndex].bAssigned && Slots[LastIndex].ParticleID >= 0)
+	{
+		Buckets[FindBucket(Slots[LastIndex].ParticleID)].SlotIndex = SlotIndex;
+	}
+	Slots.RemoveAtSwap(SlotIndex, 1, false);
+
+	// the free list is chained through slot indices which we just shuffled around, pool shrinking is rare so simply relink it
+	if (bRebuildFreeList)
+	{
+		RebuildFreeList();
+	}
+}
+
+int32 FNiagaraSkeletalSlotTable::FindSlot(int32 ParticleID) const
+{
+	if (ParticleID < 0 || Buckets.Num() == 0)
+	{
+		return INDEX_NONE;
+	}
+	const int32 BucketIndex = FindBucket(ParticleID);
+	return BucketIndex == INDEX_NONE ? INDEX_NONE : Buckets[BucketIndex].SlotIndex;
+}
+
+void FNiagaraSkeletalSlotTable::Assign(int32 SlotIndex, int32 ParticleID)
+{
+	FSlot& Slot = Slots[SlotIndex];
+	check(!Slot.bAssigned);
+	Slot.bAssigned = true;
+	Slot.ParticleID = ParticleID;
+	Slot.AliveGeneration = Generation;
+	++NumAssignedSlots;
+
+	// particles without a valid ID still hold the slot for this tick, but can't be found again and get released on the next reconcile
+	if (ParticleID >= 0)
+	{
+		InsertBucket(ParticleID, SlotIndex);
+	}
+}
+
+void FNiagaraSkeletalSlotTable::Release(int32 SlotIndex)
+{
+	FSlot& Slot = Slots[SlotIndex];
+	check(Slot.bAssigned);
+	if (Slot.ParticleID >= 0)
+	{
+		RemoveBucket(Slot.ParticleID);
+	}
+	Slot.bAssigned = false;
+	Slot.ParticleID = INDEX_NONE;
+	--NumAssignedSlots;
+	LinkFree(SlotIndex);
+}
+
+int32 FNiagaraSkeletalSlotTable::PopFree(int32 Key)
+{
+	return FreeHeads.IsValidIndex(Key + 1) ? UnlinkFreeHead(Key + 1) : INDEX_NONE;
+}
+
+int32 FNiagaraSkeletalSlotTable::PopFree()
+{
+	if (NumFreeSlots == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// there are only as many lists as mesh and animation combinations, so a linear scan is fine
+	for (int32 ListIndex = 0; ListIndex < FreeHeads.Num(); ++ListIndex)
+	{
+		if (FreeHeads[ListIndex] != INDEX_NONE)
+		{
+			return UnlinkFreeHead(ListIndex);
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FNiagaraSkeletalSlotTable::PushFree(int32 SlotIndex)
+{
+	check(!Slots[SlotIndex].bAssigned);
+	LinkFree(SlotIndex);
+}
+
+void FNiagaraSkeletalSlotTable::SetKey(int32 SlotIndex, int32 Key)
+{
+	check(!Slots[SlotIndex].bFree && Key >= INDEX_NONE);
+	Slots[SlotIndex].Key = Key;
+}
+
+void FNiagaraSkeletalSlotTable::LinkFree(int32 SlotIndex)
+{
+	FSlot& Slot = Slots[SlotIndex];
+	check(!Slot.bFree);
+	const int32 ListIndex = Slot.Key + 1;
+	if (ListIndex >= FreeHeads.Num())
+	{
+		// only grows the first time a key is seen
+		FreeHeads.SetNumUninitialized(ListIndex + 1);
+		for (int32 NewIndex = FreeHeads.Num() - 1; NewIndex >= ListIndex; --NewIndex)
+		{
+			FreeHeads[NewIndex] = INDEX_NONE;
+		}
+	}
+	Slot.NextFree = FreeHeads[ListIndex];
+	Slot.bFree = true;
+	FreeHeads[ListIndex] = SlotIndex;
+	++NumFreeSlots;
+}
+
+int32 FNiagaraSkeletalSlotTable::UnlinkFreeHead(int32 ListIndex)
+{
+	const int32 SlotIndex = FreeHeads[ListIndex];
+	if (SlotIndex != INDEX_NONE)
+	{
+		FSlot& Slot = Slots[SlotIndex];
+		FreeHeads[ListIndex] = Slot.NextFree;
+		Slot.NextFree = INDEX_NONE;
+		Slot.bFree = false;
+		--NumFreeSlots;
+	}
+	return SlotIndex;
+}
+
+int32 FNiagaraSkeletalSlotTable::FindBucket(int32 ParticleID) const
+{
+	const uint32 Mask = Buckets.Num() - 1;
+	for (uint32 BucketIndex = GetIdealBucket(ParticleID);; BucketIndex = (BucketIndex + 1) & Mask)
+	{
+		const FBucket& Bucket = Buckets[BucketIndex];
+		if (Bucket.ParticleID == ParticleID)
+		{
+			return BucketIndex;
+		}
+		if (Bucket.ParticleID == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+	}
+}
+
+void FNiagaraSkeletalSlotTable::InsertBucket(int32 ParticleID, int32 SlotIndex)
+{
+	const uint32 Mask = Buckets.Num() - 1;
+	uint32 BucketIndex = GetIdealBucket(ParticleID);
+	while (Buckets[BucketIndex].ParticleID != INDEX_NONE)
+	{
+		check(Buckets[BucketIndex].ParticleID != ParticleID);
+		BucketIndex = (BucketIndex + 1) & Mask;
+	}
+	Buckets[BucketIndex].ParticleID = ParticleID;
+	Buckets[BucketIndex].SlotIndex = SlotIndex;
+}
+
+void FNiagaraSkeletalSlotTable::RemoveBucket(int32 ParticleID)
+{
+	int32 HoleIndex = FindBucket(ParticleID);
+	check(HoleIndex != INDEX_NONE);
+
+	// Backward shift deletion, so lookups never need tombstones
+	const uint32 Mask = Buckets.Num() - 1;
+	Buckets[HoleIndex] = FBucket();
+	for (uint32 BucketIndex = (HoleIndex + 1) & Mask; Buckets[BucketIndex].ParticleID != INDEX_NONE; BucketIndex = (BucketIndex + 1) & Mask)
+	{
+		const uint32 IdealIndex = GetIdealBucket(Buckets[BucketIndex].ParticleID);
+		if (((BucketIndex - IdealIndex) & Mask) >= ((BucketIndex - HoleIndex) & Mask))
+		{
+			Buckets[HoleIndex] = Buckets[BucketIndex];
+			Buckets[BucketIndex] = FBucket();
+			HoleIndex = BucketIndex;
+		}
+	}
+}
+
+void FNiagaraSkeletalSlotTable::Rehash(int32 NumBuckets)
+{
+	check(FMath::IsPowerOfTwo(NumBuckets));
+	Buckets.Reset(NumBuckets);
+	Buckets.AddDefaulted(NumBuckets);
+	for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); ++SlotIndex)
+	{
+		if (Slots[SlotIndex].bAssigned && Slots[SlotIndex].ParticleID >= 0)
+		{
+			InsertBucket(Slots[SlotIndex].ParticleID, SlotIndex);
+		}
+	}
+}
+
+void FNiagaraSkeletalSlotTable::RebuildFreeList()
+{
+	for (int32& FreeHead : FreeHeads)
+	{
+		FreeHead = INDEX_NONE;
+	}
+	NumFreeSlots = 0;
+
+	// Only slots that were on a free list go back on one, popped slots are still owned by the caller
+	for (int32 SlotIndex = Slots.Num() - 1; SlotIndex >= 0; --SlotIndex)
+	{
+		FSlot& Slot = Slots[SlotIndex];
+		Slot.NextFree = INDEX_NONE;
+		if (Slot.bFree)
+		{
+			Slot.bFree = false;
+			LinkFree(SlotIndex);
+		}
+	}
+}
+
+bool FNiagaraSkeletalSlotTable::CheckInvariants() const
+{
+	int32 NumAssignedFound = 0;
+	int32 NumFreeFound = 0;
+	for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); ++SlotIndex)
+	{
+		const FSlot& Slot = Slots[SlotIndex];
+		if (Slot.bAssigned && Slot.bFree)
+		{
+			return false;
+		}
+		if (Slot.bAssigned)
+		{
+			++NumAssignedFound;
+			if (Slot.ParticleID >= 0 && FindSlot(Slot.ParticleID) != SlotIndex)
+			{
+				return false;
+			}
+		}
+		NumFreeFound += Slot.bFree ? 1 : 0;
+	}
+	if (NumAssignedFound != NumAssignedSlots || NumFreeFound != NumFreeSlots)
+	{
+		return false;
+	}
+
+	// every free list only chains free slots of its own key, and between them they reach all free slots
+	int32 NumLinked = 0;
+	for (int32 ListIndex = 0; ListIndex < FreeHeads.Num(); ++ListIndex)
+	{
+		for (int32 SlotIndex = FreeHeads[ListIndex]; SlotIndex != INDEX_NONE; SlotIndex = Slots[SlotIndex].NextFree)
+		{
+			if (!Slots.IsValidIndex(SlotIndex) || !Slots[SlotIndex].bFree || Slots[SlotIndex].Key + 1 != ListIndex || ++NumLinked > NumFreeSlots)
+			{
+				return false;
+			}
+		}
+	}
+	if (NumLinked != NumFreeSlots)
+	{
+		return false;
+	}
+
+	// every occupied bucket points back at an assigned slot holding its particle
+	for (const FBucket& Bucket : Buckets)
+	{
+		if (Bucket.ParticleID != INDEX_NONE && (!Slots.IsValidIndex(Bucket.SlotIndex) || !Slots[Bucket.SlotIndex].bAssigned || Slots[Bucket.SlotIndex].ParticleID != Bucket.ParticleID))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,496 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalVertexAnimation.h"
+
+#if WITH_EDITOR
+#include "Animation/AnimSequenceBase.h"
+#include "Animation/AnimationPoseData.h"
+#include "Animation/AttributesRuntime.h"
+#include "BonePose.h"
+#include "DerivedDataCacheInterface.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/Texture2D.h"
+#include "MeshDescription.h"
+#include "Rendering/SkeletalMeshLODModel.h"
+#include "Rendering/SkeletalMeshModel.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "StaticMeshAttributes.h"
+#endif
+
+// Bump whenever the bake output changes so stale DDC entries are ignored
+#define NIAGARASKELETAL_VAT_DERIVEDDATA_VER TEXT("8A0F3B6C2D7E4F1A9B5C3D2E1F0A6B7C")
+
+const FName NiagaraSkeletalVertexAnimation::PositionTextureParamName(TEXT("VATPositionTexture"));
+const FName NiagaraSkeletalVertexAnimation::NormalTextureParamName(TEXT("VATNormalTexture"));
+const FName NiagaraSkeletalVertexAnimation::TextureSizeParamName(TEXT("VATTextureSize"));
+const FName NiagaraSkeletalVertexAnimation::RowsPerFrameParamName(TEXT("VATRowsPerFrame"));
+const FName NiagaraSkeletalVertexAnimation::BoneTextureParamName(TEXT("VATBoneTexture"));
+
+FArchive& operator<<(FArchive& Ar, FNiagaraSkeletalVATBakeData& Data)
+{
+	Ar << Data.NumVertices << Data.TextureWidth << Data.RowsPerFrame << Data.NumFrames;
+	Ar << Data.Animations;
+	Ar << Data.PositionTexels << Data.NormalTexels;
+	Ar << Data.NumBones << Data.BoneTexels << Data.BoneIndices << Data.BoneWeights;
+	Ar << Data.RestPositions << Data.RestNormals << Data.TexCoords << Data.Indices << Data.Sections;
+	Ar << Data.AnimatedBounds;
+	return Ar;
+}
+
+void NiagaraSkeletalVertexAnimation::SampleAnimation(const FNiagaraSkeletalVATAnimationRange& Range, float AnimTime, int32& OutFrameA, int32& OutFrameB, float& OutBlend)
+{
+	if (Range.NumFrames < 2 || Range.Length <= UE_SMALL_NUMBER)
+	{
+		OutFrameA = Range.StartFrame;
+		OutFrameB = Range.StartFrame;
+		OutBlend = 0.0f;
+		return;
+	}
+
+	float LoopTime = FMath::Fmod(AnimTime, Range.Length);
+	if (LoopTime < 0.0f)
+	{
+		LoopTime += Range.Length;
+	}
+
+	const float Frame = LoopTime / Range.Length * float(Range.NumFrames - 1);
+	const int32 FrameIndex = FMath::Clamp(FMath::FloorToInt(Frame), 0, Range.NumFrames - 2);
+	OutFrameA = Range.StartFrame + FrameIndex;
+	OutFrameB = OutFrameA + 1;
+	OutBlend = FMath::Clamp(Frame - float(FrameIndex), 0.0f, 1.0f);
+}
+
+void NiagaraSkeletalVertexAnimation::ComputeTextureLayout(int32 NumVertices, int32& OutTextureWidth, int32& OutRowsPerFrame)
+{
+	OutTextureWidth = FMath::Clamp(NumVertices, 1, MaxTextureSize);
+	OutRowsPerFrame = FMath::DivideAndRoundUp(FMath::Max(NumVertices, 1), OutTextureWidth);
+}
+
+#if WITH_EDITOR
+
+namespace NiagaraSkeletalVertexAnimationLocal
+{
+	int32 GetNumBakedFrames(const UAnimSequenceBase* Sequence, float FrameRate)
+	{
+		// plus one for the closing frame
+		return Sequence ? FMath::Max(1, FMath::CeilToInt(Sequence->GetPlayLength() * FrameRate)) + 1 : 0;
+	}
+
+	// Component space skinning matrices for every bone of the mesh at the given time
+	void EvaluateSkinningMatrices(USkeletalMesh* SkeletalMesh, const FBoneContainer& BoneContainer, const UAnimSequenceBase* Sequence, float Time, TArray<FTransform>& ComponentSpace, TArray<FMatrix44f>& OutSkinningMatrices)
+	{
+		const FReferenceSkeleton& RefSkeleton = SkeletalMesh->GetRefSkeleton();
+		const TArray<FMatrix44f>& RefBasesInvMatrix = SkeletalMesh->GetRefBasesInvMatrix();
+
+		FMemMark Mark(FMemStack::Get());
+		FCompactPose Pose;
+		Pose.SetBoneContainer(&BoneContainer);
+		FBlendedCurve Curve;
+		Curve.InitFrom(BoneContainer);
+		UE::Anim::FStackAttributeContainer Attributes;
+		FAnimationPoseData PoseData(Pose, Curve, Attributes);
+		Sequence->GetAnimationPose(PoseData, FAnimExtractContext(double(Time)));
+
+		// compact pose bones are ordered parents first, so one pass is enough to go to component space
+		ComponentSpace.SetNum(RefSkeleton.GetNum());
+		for (FCompactPoseBoneIndex BoneIndex : Pose.ForEachBoneIndex())
+		{
+			const int32 MeshBoneIndex = BoneContainer.MakeMeshPoseIndex(BoneIndex).GetInt();
+			const int32 ParentIndex = RefSkeleton.GetParentIndex(MeshBoneIndex);
+			ComponentSpace[MeshBoneIndex] = ParentIndex == INDEX_NONE ? Pose[BoneIndex] : Pose[BoneIndex] * ComponentSpace[ParentIndex];
+		}
+
+		OutSkinningMatrices.SetNum(RefSkeleton.GetNum());
+		for (int32 BoneIndex = 0; BoneIndex < RefSkeleton.GetNum(); ++BoneIndex)
+		{
+			OutSkinningMatrices[BoneIndex] = RefBasesInvMatrix[BoneIndex] * FMatrix44f(ComponentSpace[BoneIndex].ToMatrixWithScale());
+		}
+	}
+
+	UTexture2D* CreateBakeTexture(UObject* Outer, const TCHAR* BaseName, int32 Width, int32 Height, ETextureSourceFormat Format, TextureCompressionSettings Compression, const void* Data)
+	{
+		UTexture2D* Texture = NewObject<UTexture2D>(Outer, MakeUniqueObjectName(Outer, UTexture2D::StaticClass(), BaseName));
+		Texture->Source.Init(Width, Height, 1, 1, Format, static_cast<const uint8*>(Data));
+		Texture->CompressionSettings = Compression;
+		Texture->SRGB = false;
+		Texture->Filter = TF_Nearest;
+		Texture->MipGenSettings = TMGS_NoMipmaps;
+		Texture->AddressX = TA_Clamp;
+		Texture->AddressY = TA_Clamp;
+		Texture->NeverStream = true;
+		Texture->PostEditChange();
+		return Texture;
+	}
+
+	UStaticMesh* CreateBakeStaticMesh(UObject* Outer, USkeletalMesh* SkeletalMesh, const FNiagaraSkeletalVATBakeData& Data)
+	{
+		FMeshDescription MeshDescription;
+		FStaticMeshAttributes Attributes(MeshDescription);
+		Attributes.Register();
+
+		TVertexAttributesRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
+		TVertexInstanceAttributesRef<FVector3f> VertexNormals = Attributes.GetVertexInstanceNormals();
+		TVertexInstanceAttributesRef<FVector2f> VertexUVs = Attributes.GetVertexInstanceUVs();
+		TPolygonGroupAttributesRef<FName> MaterialSlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+		const bool bSkinned = Data.BoneIndices.Num() == Data.NumVertices;
+		VertexUVs.SetNumChannels(bSkinned ? NiagaraSkeletalVertexAnimation::BoneWeightsUVChannel + 2 : NiagaraSkeletalVertexAnimation::VertexUVChannel + 1);
+
+		// One vertex instance per baked vertex, the texel coordinate in the extra UV channel survives any reordering the mesh build does
+		TArray<FVertexInstanceID> VertexInstances;
+		VertexInstances.Reserve(Data.NumVertices);
+		MeshDescription.ReserveNewVertices(Data.NumVertices);
+		MeshDescription.ReserveNewVertexInstances(Data.NumVertices);
+		MeshDescription.ReserveNewTriangles(Data.Indices.Num() / 3);
+		for (int32 VertexIndex = 0; VertexIndex < Data.NumVertices; ++VertexIndex)
+		{
+			const FVertexID VertexID = MeshDescription.CreateVertex();
+			VertexPositions[VertexID] = Data.RestPositions[VertexIndex];
+
+			const FVertexInstanceID VertexInstanceID = MeshDescription.CreateVertexInstance(VertexID);
+			VertexNormals[VertexInstanceID] = Data.RestNormals[VertexIndex];
+			VertexUVs.Set(VertexInstanceID, 0, Data.TexCoords[VertexIndex]);
+			VertexUVs.Set(VertexInstanceID, NiagaraSkeletalVertexAnimation::VertexUVChannel, FVector2f(
+				(float(VertexIndex % Data.TextureWidth) + 0.5f) / float(Data.TextureWidth),
+				float(VertexIndex / Data.TextureWidth)));
+			if (bSkinned)
+			{
+				const FIntVector4& Bones = Data.BoneIndices[VertexIndex];
+				const FVector4f& Weights = Data.BoneWeights[VertexIndex];
+				VertexUVs.Set(VertexInstanceID, NiagaraSkeletalVertexAnimation::BoneIndicesUVChannel, FVector2f(float(Bones.X), float(Bones.Y)));
+				VertexUVs.Set(VertexInstanceID, NiagaraSkeletalVertexAnimation::BoneIndicesUVChannel + 1, FVector2f(float(Bones.Z), float(Bones.W)));
+				VertexUVs.Set(VertexInstanceID, NiagaraSkeletalVertexAnimation::BoneWeightsUVChannel, FVector2f(Weights.X, Weights.Y));
+				VertexUVs.Set(VertexInstanceID, NiagaraSkeletalVertexAnimation::BoneWeightsUVChannel + 1, FVector2f(Weights.Z, Weights.W));
+			}
+			VertexInstances.Add(VertexInstanceID);
+		}
+
+		UStaticMesh* StaticMesh = NewObject<UStaticMesh>(Outer, MakeUniqueObjectName(Outer, UStaticMesh::StaticClass(), TEXT("VAT_StaticMesh")));
+		const TArray<FSkeletalMaterial>& SkeletalMaterials = SkeletalMesh->GetMaterials();
+		for (const FSkeletalMaterial& SkeletalMaterial : SkeletalMaterials)
+		{
+			StaticMesh->GetStaticMaterials().Add(FStaticMaterial(SkeletalMaterial.MaterialInterface, SkeletalMaterial.MaterialSlotName, SkeletalMaterial.MaterialSlotName));
+		}
+
+		for (int32 SectionIndex = 0; SectionIndex < Data.Sections.Num(); ++SectionIndex)
+		{
+			const FIntVector& Section = Data.Sections[SectionIndex];
+			const FPolygonGroupID PolygonGroupID = MeshDescription.CreatePolygonGroup();
+			MaterialSlotNames[PolygonGroupID] = SkeletalMaterials.IsValidIndex(Section.Z) ? SkeletalMaterials[Section.Z].MaterialSlotName : NAME_None;
+			for (int32 TriangleIndex = 0; TriangleIndex < Section.Y; ++TriangleIndex)
+			{
+				const int32 FirstIndex = Section.X + TriangleIndex * 3;
+				const FVertexInstanceID Corners[3] = { VertexInstances[Data.Indices[FirstIndex]], VertexInstances[Data.Indices[FirstIndex + 1]], VertexInstances[Data.Indices[FirstIndex + 2]] };
+				MeshDescription.CreateTriangle(PolygonGroupID, Corners);
+			}
+			StaticMesh->GetSectionInfoMap().Set(0, SectionIndex, FMeshSectionInfo(FMath::Max(Section.Z, 0)));
+		}
+
+		FStaticMeshSourceModel& SourceModel = StaticMesh->AddSourceModel();
+		SourceModel.BuildSettings.bRecomputeNormals = false;
+		SourceModel.BuildSettings.bRecomputeTangents = true;
+		SourceModel.BuildSettings.bRemoveDegenerates = false;
+		SourceModel.BuildSettings.bGenerateLightmapUVs = false;
+		SourceModel.BuildSettings.bUseFullPrecisionUVs = true;
+		StaticMesh->CreateMeshDescription(0, MoveTemp(MeshDescription));
+		StaticMesh->CommitMeshDescription(0);
+
+		// the rest pose bounds don't cover the animation, extend them so instances aren't culled while playing
+		FBox3f RestBounds(ForceInit);
+		for (const FVector3f& Position : Data.RestPositions)
+		{
+			RestBounds += Position;
+		}
+		if (Data.AnimatedBounds.IsValid && RestBounds.IsValid)
+		{
+			StaticMesh->SetPositiveBoundsExtension(FVector(FVector3f::Max(Data.AnimatedBounds.Max - RestBounds.Max, FVector3f::ZeroVector)));
+			StaticMesh->SetNegativeBoundsExtension(FVector(FVector3f::Max(RestBounds.Min - Data.AnimatedBounds.Min, FVector3f::ZeroVector)));
+		}
+
+		StaticMesh->Build(true);
+		StaticMesh->PostEditChange();
+		return StaticMesh;
+	}
+
+	// The saved hashes don't change until the assets are saved, so the mesh also contributes the ID of its imported model, which any edit to the
+	// geometry or skinning renews. Animations have no such ID on every engine version, see HasUnsavedInputs
+	FString MakeBakeKey(USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations, float FrameRate, bool bBakeBones)
+	{
+		const FSkeletalMeshModel* ImportedModel = SkeletalMesh->GetImportedModel();
+		FString KeySuffix = FString::Printf(TEXT("%s_%s_%s_%g_%s"), *SkeletalMesh->GetPathName(), *LexToString(SkeletalMesh->GetPackage()->GetSavedHash()),
+			ImportedModel ? *ImportedModel->GetIdString() : TEXT("None"), FrameRate, bBakeBones ? TEXT("B") : TEXT("V"));
+		for (const UAnimationAsset* Animation : Animations)
+		{
+			KeySuffix += Animation ? FString::Printf(TEXT("_%s_%s"), *Animation->GetPathName(), *LexToString(Animation->GetPackage()->GetSavedHash())) : FString(TEXT("_None"));
+		}
+		return FDerivedDataCacheInterface::BuildCacheKey(TEXT("NIAGARASKELETALVAT"), NIAGARASKELETAL_VAT_DERIVEDDATA_VER, *FString::Printf(TEXT("%08X"), FCrc::StrCrc32(*KeySuffix)) + KeySuffix.Right(64));
+	}
+
+	// A bake of assets with unsaved edits can't be told apart from the saved version by its key, it is always baked fresh and kept out of the cache.
+	// Transient assets were never saved, every one of them has the same empty saved hash
+	bool IsUnsaved(const UObject* Asset)
+	{
+		const UPackage* Package = Asset->GetPackage();
+		return Package == GetTransientPackage() || Package->IsDirty();
+	}
+
+	bool HasUnsavedInputs(USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations)
+	{
+		if (IsUnsaved(SkeletalMesh))
+		{
+			return true;
+		}
+		for (const UAnimationAsset* Animation : Animations)
+		{
+			if (Animation && IsUnsaved(Animation))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool NiagaraSkeletalVertexAnimation::Bake(USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations, float FrameRate, bool bBakeBones, FNiagaraSkeletalVATBakeData& OutData)
+{
+	using namespace NiagaraSkeletalVertexAnimationLocal;
+
+	const FSkeletalMeshModel* ImportedModel = SkeletalMesh ? SkeletalMesh->GetImportedModel() : nullptr;
+	if (!ImportedModel || ImportedModel->LODModels.Num() == 0 || FrameRate <= 0.0f)
+	{
+		return false;
+	}
+	const FSkeletalMeshLODModel& LODModel = ImportedModel->LODModels[0];
+
+	const FReferenceSkeleton& RefSkeleton = SkeletalMesh->GetRefSkeleton();
+	OutData = FNiagaraSkeletalVATBakeData();
+	OutData.NumVertices = LODModel.NumVertices;
+	if (bBakeBones)
+	{
+		// every frame is a single row of three texels per bone
+		OutData.NumBones = RefSkeleton.GetNum();
+		OutData.TextureWidth = OutData.NumBones * 3;
+		OutData.RowsPerFrame = 1;
+		if (OutData.TextureWidth > MaxTextureSize)
+		{
+			GLog->Logf(ELogVerbosity::Error, TEXT("Can't bake %s for instanced skinning, its %d bones don't fit in a %d texels wide texture"), *SkeletalMesh->GetName(), OutData.NumBones, MaxTextureSize);
+			return false;
+		}
+	}
+	else
+	{
+		ComputeTextureLayout(OutData.NumVertices, OutData.TextureWidth, OutData.RowsPerFrame);
+	}
+
+	// Lower the frame rate until every animation fits in the texture, every animation keeps at least two frames so that may never happen
+	const int32 MaxFrames = MaxTextureSize / OutData.RowsPerFrame;
+	auto CountFrames = [Animations](float InFrameRate)
+	{
+		int32 TotalFrames = 0;
+		for (const UAnimationAsset* Animation : Animations)
+		{
+			TotalFrames += GetNumBakedFrames(Cast<UAnimSequenceBase>(Animation), InFrameRate);
+		}
+		return TotalFrames;
+	};
+	int32 TotalFrames = CountFrames(FrameRate);
+	for (int32 Attempt = 0; Attempt < 8 && TotalFrames > MaxFrames && MaxFrames > 0; ++Attempt)
+	{
+		FrameRate *= float(MaxFrames) / float(TotalFrames) * 0.95f;
+		TotalFrames = CountFrames(FrameRate);
+	}
+	if (TotalFrames > MaxFrames)
+	{
+		GLog->Logf(ELogVerbosity::Error, TEXT("Can't bake %s, %d frames of %d rows don't fit in a %d texels high texture even at %.2f frames per second"),
+			*SkeletalMesh->GetName(), TotalFrames, OutData.RowsPerFrame, MaxTextureSize, FrameRate);
+		return false;
+	}
+
+	// Rest pose, in the same order as the LOD model's index buffer references vertices
+	OutData.RestPositions.Reserve(OutData.NumVertices);
+	OutData.RestNormals.Reserve(OutData.NumVertices);
+	OutData.TexCoords.Reserve(OutData.NumVertices);
+	for (const FSkelMeshSection& Section : LODModel.Sections)
+	{
+		for (const FSoftSkinVertex& Vertex : Section.SoftVertices)
+		{
+			OutData.RestPositions.Add(Vertex.Position);
+			OutData.RestNormals.Add(FVector3f(Vertex.TangentZ));
+			OutData.TexCoords.Add(Vertex.UVs[0]);
+
+			if (bBakeBones)
+			{
+				// influences are imported sorted by weight, the shader only skins with the strongest four
+				FIntVector4& Bones = OutData.BoneIndices.AddZeroed_GetRef();
+				FVector4f& Weights = OutData.BoneWeights.AddZeroed_GetRef();
+				float TotalWeight = 0.0f;
+				for (int32 Influence = 0; Influence < FMath::Min(NumBoneInfluences, MAX_TOTAL_INFLUENCES); ++Influence)
+				{
+					Bones[Influence] = Section.BoneMap[Vertex.InfluenceBones[Influence]];
+					Weights[Influence] = float(Vertex.InfluenceWeights[Influence]);
+					TotalWeight += Weights[Influence];
+				}
+				Weights = TotalWeight > 0.0f ? Weights / TotalWeight : FVector4f(1.0f, 0.0f, 0.0f, 0.0f);
+			}
+		}
+		OutData.Sections.Emplace(Section.BaseIndex, Section.NumTriangles, Section.MaterialIndex);
+	}
+	OutData.Indices = LODModel.IndexBuffer;
+	check(OutData.RestPositions.Num() == OutData.NumVertices);
+
+	TArray<FBoneIndexType> RequiredBones;
+	RequiredBones.SetNumUninitialized(RefSkeleton.GetNum());
+	for (int32 BoneIndex = 0; BoneIndex < RequiredBones.Num(); ++BoneIndex)
+	{
+		RequiredBones[BoneIndex] = FBoneIndexType(BoneIndex);
+	}
+	FBoneContainer BoneContainer(RequiredBones, FCurveEvaluationOption(false), *SkeletalMesh);
+
+	TArray<FTransform> ComponentSpace;
+	TArray<FMatrix44f> SkinningMatrices;
+	for (const UAnimationAsset* Animation : Animations)
+	{
+		const UAnimSequenceBase* Sequence = Cast<UAnimSequenceBase>(Animation);
+		FNiagaraSkeletalVATAnimationRange& Range = OutData.Animations.AddDefaulted_GetRef();
+		Range.StartFrame = OutData.NumFrames;
+		Range.NumFrames = GetNumBakedFrames(Sequence, FrameRate);
+		Range.Length = Sequence ? Sequence->GetPlayLength() : 0.0f;
+		OutData.NumFrames += Range.NumFrames;
+
+		for (int32 Frame = 0; Frame < Range.NumFrames; ++Frame)
+		{
+			const float Time = Range.NumFrames > 1 ? Range.Length * float(Frame) / float(Range.NumFrames - 1) : 0.0f;
+			EvaluateSkinningMatrices(SkeletalMesh, BoneContainer, Sequence, Time, ComponentSpace, SkinningMatrices);
+
+			const int32 FirstTexel = (Range.StartFrame + Frame) * OutData.TextureWidth * OutData.RowsPerFrame;
+			if (bBakeBones)
+			{
+				// store the matrix columns so the shader skins with three dot products
+				FFloat16* BoneTexel = &OutData.BoneTexels[OutData.BoneTexels.AddZeroed(OutData.TextureWidth * 4)];
+				for (int32 BoneIndex = 0; BoneIndex < OutData.NumBones; ++BoneIndex)
+				{
+					const FMatrix44f& SkinningMatrix = SkinningMatrices[BoneIndex];
+					for (int32 Column = 0; Column < 3; ++Column)
+					{
+						for (int32 Row = 0; Row < 4; ++Row)
+						{
+							*BoneTexel++ = SkinningMatrix.M[Row][Column];
+						}
+					}
+				}
+			}
+			else
+			{
+				OutData.PositionTexels.AddZeroed(OutData.TextureWidth * OutData.RowsPerFrame * 4);
+				OutData.NormalTexels.AddZeroed(OutData.TextureWidth * OutData.RowsPerFrame);
+			}
+
+			int32 VertexIndex = 0;
+			for (const FSkelMeshSection& Section : LODModel.Sections)
+			{
+				for (const FSoftSkinVertex& Vertex : Section.SoftVertices)
+				{
+					uint32 TotalWeight = 0;
+					for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; ++Influence)
+					{
+						TotalWeight += Vertex.InfluenceWeights[Influence];
+					}
+
+					FVector3f Position = FVector3f::ZeroVector;
+					FVector3f Normal = FVector3f::ZeroVector;
+					for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES && TotalWeight > 0; ++Influence)
+					{
+						if (Vertex.InfluenceWeights[Influence] == 0)
+						{
+							continue;
+						}
+						const float Weight = float(Vertex.InfluenceWeights[Influence]) / float(TotalWeight);
+						const FMatrix44f& SkinningMatrix = SkinningMatrices[Section.BoneMap[Vertex.InfluenceBones[Influence]]];
+						Position += SkinningMatrix.TransformPosition(Vertex.Position) * Weight;
+						Normal += SkinningMatrix.TransformVector(FVector3f(Vertex.TangentZ)) * Weight;
+					}
+					OutData.AnimatedBounds += Position;
+					if (bBakeBones)
+					{
+						// the vertices are only skinned here to know the animated bounds
+						++VertexIndex;
+						continue;
+					}
+
+					const FVector3f Offset = Position - Vertex.Position;
+					FFloat16* PositionTexel = &OutData.PositionTexels[(FirstTexel + VertexIndex) * 4];
+					PositionTexel[0] = Offset.X;
+					PositionTexel[1] = Offset.Y;
+					PositionTexel[2] = Offset.Z;
+					PositionTexel[3] = 1.0f;
+					OutData.NormalTexels[FirstTexel + VertexIndex] = FLinearColor(Normal.GetSafeNormal() * 0.5f + 0.5f).ToFColor(false);
+					++VertexIndex;
+				}
+			}
+		}
+	}
+
+	return OutData.NumFrames > 0;
+}
+
+bool NiagaraSkeletalVertexAnimation::BakeAssets(UObject* Outer, USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations, float FrameRate, bool bBakeBones, FNiagaraSkeletalVertexAnimationBake& InOutBake)
+{
+	using namespace NiagaraSkeletalVertexAnimationLocal;
+
+	if (!SkeletalMesh)
+	{
+		InOutBake = FNiagaraSkeletalVertexAnimationBake();
+		return false;
+	}
+
+	const FString BakeKey = MakeBakeKey(SkeletalMesh, Animations, FrameRate, bBakeBones);
+	const bool bUseCache = !HasUnsavedInputs(SkeletalMesh, Animations);
+	if (bUseCache && InOutBake.BakeKey == BakeKey && InOutBake.IsValid())
+	{
+		return true;
+	}
+
+	FNiagaraSkeletalVATBakeData Data;
+	TArray<uint8> DerivedData;
+	if (bUseCache && GetDerivedDataCacheRef().GetSynchronous(*BakeKey, DerivedData, SkeletalMesh->GetPathName()))
+	{
+		FMemoryReader Ar(DerivedData, true);
+		Ar << Data;
+	}
+	else
+	{
+		if (!Bake(SkeletalMesh, Animations, FrameRate, bBakeBones, Data))
+		{
+			InOutBake = FNiagaraSkeletalVertexAnimationBake();
+			return false;
+		}
+		if (bUseCache)
+		{
+			FMemoryWriter Ar(DerivedData, true);
+			Ar << Data;
+			GetDerivedDataCacheRef().Put(*BakeKey, DerivedData, SkeletalMesh->GetPathName());
+		}
+	}
+
+	const int32 TextureHeight = Data.RowsPerFrame * Data.NumFrames;
+	InOutBake = FNiagaraSkeletalVertexAnimationBake();
+	if (bBakeBones)
+	{
+		InOutBake.BoneTexture = CreateBakeTexture(Outer, TEXT("VAT_Bones"), Data.TextureWidth, TextureHeight, TSF_RGBA16F, TC_HDR, Data.BoneTexels.GetData());
+	}
+	else
+	{
+		InOutBake.PositionTexture = CreateBakeTexture(Outer, TEXT("VAT_Position"), Data.TextureWidth, TextureHeight, TSF_RGBA16F, TC_HDR, Data.PositionTexels.GetData());
+		InOutBake.NormalTexture = CreateBakeTexture(Outer, TEXT("VAT_Normal"), Data.TextureWidth, TextureHeight, TSF_BGRA8, TC_VectorDisplacementmap, Data.NormalTexels.GetData());
+	}
+	InOutBake.StaticMesh = CreateBakeStaticMesh(Outer, SkeletalMesh, Data);
+	InOutBake.Animations = Data.Animations;
+	InOutBake.RowsPerFrame = Data.RowsPerFrame;
+	InOutBake.NumFrames = Data.NumFrames;
+	// nothing to compare against next time, the unsaved edits may have moved on by then
+	InOutBake.BakeKey = bUseCache ? BakeKey : FString();
+	return InOutBake.IsValid();
+}
+
+#endif // WITH_EDITOR
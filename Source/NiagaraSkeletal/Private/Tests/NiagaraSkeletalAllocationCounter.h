@@ -0,0 +1,88 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/MemoryBase.h"
+#include <atomic>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Counts the heap allocations the calling thread makes while it is alive, by putting itself in front of GMalloc. Every other thread keeps
+// allocating through it uncounted. Platforms that call their allocator without going through GMalloc always count zero.
+// Reallocations count as allocations, even the ones the allocator manages to do in place.
+class FNiagaraSkeletalScopedAllocationCounter
+{
+public:
+	FNiagaraSkeletalScopedAllocationCounter()
+	{
+		FCountingMalloc& CountingMalloc = FCountingMalloc::Get();
+		check(GMalloc != &CountingMalloc);
+		CountingMalloc.Inner = GMalloc;
+		CountingMalloc.NumAllocations = 0;
+		CountingMalloc.CountedThreadId = FPlatformTLS::GetCurrentThreadId();
+		GMalloc = &CountingMalloc;
+	}
+
+	~FNiagaraSkeletalScopedAllocationCounter()
+	{
+		// Inner is left as is, other threads may still be on their way through the counting allocator
+		FCountingMalloc& CountingMalloc = FCountingMalloc::Get();
+		GMalloc = CountingMalloc.Inner;
+		CountingMalloc.CountedThreadId = 0;
+	}
+
+	int64 GetNumAllocations() const { return FCountingMalloc::Get().NumAllocations; }
+
+private:
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		static FCountingMalloc& Get()
+		{
+			static FCountingMalloc Instance;
+			return Instance;
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+		FMalloc* Inner = nullptr;
+		// read by every allocating thread, written by the counted one only
+		std::atomic<uint32> CountedThreadId{ 0 };
+		int64 NumAllocations = 0;
+
+	private:
+		void CountAllocation()
+		{
+			if (FPlatformTLS::GetCurrentThreadId() == CountedThreadId.load(std::memory_order_relaxed))
+			{
+				++NumAllocations;
+			}
+		}
+	};
+};
+
+#endif
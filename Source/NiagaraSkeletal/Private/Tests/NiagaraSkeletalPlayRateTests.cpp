@@ -0,0 +1,48 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "FNiagaraRendererSkeletal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalPlayRateLeaderHandoffTest, "Niagara.Skeletal.PlayRate.LeaderHandoff",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+// A component follows another's pose for a while, then its leader's particle dies and it takes over. It has to start playing at its
+// particle's rate straight away, across the loop point too, instead of jumping from wherever the time it showed as a follower was
+bool FNiagaraSkeletalPlayRateLeaderHandoffTest::RunTest(const FString& Parameters)
+{
+	const float AnimLength = 2.0f;
+	const float DeltaSeconds = 1.0f / 30.0f;
+	const float ParticleRate = 1.5f;
+	const int32 NumFollowerTicks = 6;
+	const int32 NumTicks = 12;
+
+	FNiagaraSkeletalPlayRateTracker Tracker;
+	TestEqual(TEXT("Rate before anything was recorded"), Tracker.GetPlayRate(0.5f, AnimLength, DeltaSeconds), 1.0f);
+
+	// starts close enough to the end that the particle loops while its component is a follower
+	float ParticleTime = 1.85f;
+	for (int32 Tick = 0; Tick < NumTicks; ++Tick)
+	{
+		const bool bLeader = Tick >= NumFollowerTicks;
+		const float ParticleAnimTime = FMath::Fmod(ParticleTime, AnimLength);
+		const float PlayRate = Tracker.GetPlayRate(ParticleAnimTime, AnimLength, DeltaSeconds);
+		if (Tick > 0)
+		{
+			TestEqual(FString::Printf(TEXT("Rate on tick %d as a %s"), Tick, bLeader ? TEXT("leader") : TEXT("follower")), PlayRate, ParticleRate, 1.0e-3f);
+		}
+		// followers show their leader's pose, the particle's own time is what gets recorded either way
+		Tracker.Record(ParticleAnimTime);
+		ParticleTime += ParticleRate * DeltaSeconds;
+	}
+
+	// a component handed to another particle starts over
+	Tracker.Reset();
+	TestEqual(TEXT("Rate after a reset"), Tracker.GetPlayRate(0.5f, AnimLength, DeltaSeconds), 1.0f);
+	Tracker.Record(0.5f);
+	TestEqual(TEXT("Rate without time passing"), Tracker.GetPlayRate(0.6f, AnimLength, 0.0f), 1.0f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,190 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalBenchmark.h"
+#include "NiagaraSkeletalRendererProperties.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+#include "Engine/Engine.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DefaultValueHelper.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NiagaraComponent.h"
+#include "NiagaraEditorUtilities.h"
+#include "NiagaraEmitter.h"
+#include "NiagaraEmitterFactoryNew.h"
+#include "NiagaraFunctionLibrary.h"
+#include "NiagaraSystem.h"
+#include "NiagaraSystemFactoryNew.h"
+#include "ViewModels/Stack/NiagaraStackGraphUtilities.h"
+
+// Spawns a system built here, one emitter with the default modules and a skeletal renderer, ticks it in a game world and writes what the
+// benchmark recorder saw as JSON to Saved/NiagaraSkeletal/Benchmark. Meant for headless runs that gate plugin upgrades, e.g.
+//   UnrealEditor-Cmd <Project> -nullrhi -unattended -ExecCmds="Automation RunTests Niagara.Skeletal.Benchmark; Quit"
+namespace NiagaraSkeletalBenchmarkTests
+{
+	struct FScenario
+	{
+		int32 NumParticles = 100;
+		// share of the particles replaced every second, the particles live 1 / ChurnRate seconds
+		float ChurnRate = 0.5f;
+		bool bAssignComponentsOnParticleID = true;
+	};
+
+	static const int32 NumWarmupFrames = 60;
+	static const int32 NumRecordedFrames = 300;
+	static const float FrameSeconds = 1.0f / 30.0f;
+
+	// Overrides a module input's literal, returns false when the module has no such input
+	static bool SetModuleInput(UNiagaraScript* Script, const FString& UniqueEmitterName, const TCHAR* AliasedInputName, float Value)
+	{
+		const FNiagaraVariable Parameter = FNiagaraStackGraphUtilities::CreateRapidIterationParameter(UniqueEmitterName, Script->GetUsage(), AliasedInputName, FNiagaraTypeDefinition::GetFloatDef());
+		if (Script->RapidIterationParameters.IndexOf(Parameter) == INDEX_NONE)
+		{
+			return false;
+		}
+		Script->RapidIterationParameters.SetParameterValue(Value, Parameter);
+		return true;
+	}
+
+	static UNiagaraSystem* CreateSystem(FAutomationTestBase& Test, const FScenario& Scenario, USkeletalMesh* SkeletalMesh)
+	{
+		UNiagaraSystem* System = NewObject<UNiagaraSystem>(GetTransientPackage(), NAME_None, RF_Transient);
+		UNiagaraSystemFactoryNew::InitializeSystem(System, true);
+
+		UNiagaraEmitter* TemplateEmitter = NewObject<UNiagaraEmitter>(GetTransientPackage(), NAME_None, RF_Transient);
+		UNiagaraEmitterFactoryNew::InitializeEmitter(TemplateEmitter, true);
+		FNiagaraEditorUtilities::AddEmitterToSystem(*System, *TemplateEmitter, TemplateEmitter->GetExposedVersion().VersionGuid);
+
+		const FNiagaraEmitterHandle& EmitterHandle = System->GetEmitterHandle(0);
+		const FVersionedNiagaraEmitter VersionedEmitter = EmitterHandle.GetInstance();
+		FVersionedNiagaraEmitterData* EmitterData = EmitterHandle.GetEmitterData();
+		EmitterData->bRequiresPersistentIDs = Scenario.bAssignComponentsOnParticleID;
+
+		// the particle count settles at spawn rate times lifetime
+		const FString EmitterName = EmitterHandle.GetUniqueInstanceName();
+		const float Lifetime = 1.0f / Scenario.ChurnRate;
+		const bool bSetSpawnRate = SetModuleInput(EmitterData->EmitterUpdateScriptProps.Script, EmitterName, TEXT("SpawnRate.SpawnRate"), float(Scenario.NumParticles) * Scenario.ChurnRate);
+		bool bSetLifetime = SetModuleInput(EmitterData->SpawnScriptProps.Script, EmitterName, TEXT("InitializeParticle.Lifetime"), Lifetime);
+		bSetLifetime |= SetModuleInput(EmitterData->SpawnScriptProps.Script, EmitterName, TEXT("InitializeParticle.Lifetime Min"), Lifetime);
+		bSetLifetime |= SetModuleInput(EmitterData->SpawnScriptProps.Script, EmitterName, TEXT("InitializeParticle.Lifetime Max"), Lifetime);
+		if (!Test.TestTrue(TEXT("Default emitter has spawn rate and lifetime inputs"), bSetSpawnRate && bSetLifetime))
+		{
+			return nullptr;
+		}
+
+		// only the skeletal renderer, so the recorded phases aren't shared with anything else
+		for (UNiagaraRendererProperties* Renderer : TArray<UNiagaraRendererProperties*>(EmitterData->GetRenderers()))
+		{
+			VersionedEmitter.Emitter->RemoveRenderer(Renderer, VersionedEmitter.Version);
+		}
+		UNiagaraSkeletalRendererProperties* Renderer = NewObject<UNiagaraSkeletalRendererProperties>(VersionedEmitter.Emitter, NAME_None, RF_Transient);
+		Renderer->SkeletalMeshes.AddDefaulted_GetRef().SkeletalMesh = SkeletalMesh;
+		// past a thousand components the engine's own per component cost drowns out the renderer's
+		Renderer->ComponentCountLimit = FMath::Min(Scenario.NumParticles, 1000);
+		Renderer->bAssignComponentsOnParticleID = Scenario.bAssignComponentsOnParticleID;
+		VersionedEmitter.Emitter->AddRenderer(Renderer, VersionedEmitter.Version);
+
+		System->RequestCompile(false);
+		System->WaitForCompilationComplete();
+		if (!Test.TestTrue(TEXT("System compiled"), System->IsValid()))
+		{
+			return nullptr;
+		}
+		return System;
+	}
+
+	static bool RunScenario(FAutomationTestBase& Test, const FScenario& Scenario)
+	{
+		USkeletalMesh* SkeletalMesh = LoadObject<USkeletalMesh>(nullptr, TEXT("/Engine/EngineMeshes/SkeletalCube.SkeletalCube"));
+		if (!Test.TestNotNull(TEXT("Skeletal mesh"), SkeletalMesh))
+		{
+			return false;
+		}
+		UNiagaraSystem* System = CreateSystem(Test, Scenario, SkeletalMesh);
+		if (!System)
+		{
+			return false;
+		}
+
+		UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("NiagaraSkeletalBenchmark"));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+
+		IConsoleVariable* BenchmarkVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("fx.Niagara.Skeletal.Benchmark"));
+		const int32 PreviousBenchmarkValue = BenchmarkVariable->GetInt();
+		BenchmarkVariable->Set(1, ECVF_SetByCode);
+
+		UNiagaraComponent* Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(World, System, FVector::ZeroVector, FRotator::ZeroRotator, FVector(1.0f), false, true, ENCPoolMethod::None, true);
+		const bool bSpawned = Test.TestNotNull(TEXT("Niagara component"), Component);
+		for (int32 Frame = 0; bSpawned && Frame < NumWarmupFrames + NumRecordedFrames; ++Frame)
+		{
+			// only the steady state is recorded, the warmup fills the pool and the particle count
+			if (Frame == NumWarmupFrames)
+			{
+				NiagaraSkeletalBenchmark::Reset();
+			}
+			World->Tick(LEVELTICK_All, FrameSeconds);
+		}
+
+		if (bSpawned)
+		{
+			const FString Json = FString::Printf(TEXT("{\"particles\":%d,\"churnRate\":%g,\"assignComponentsOnParticleID\":%s,\"frames\":%d,\"recording\":%s}"),
+				Scenario.NumParticles, Scenario.ChurnRate, Scenario.bAssignComponentsOnParticleID ? TEXT("true") : TEXT("false"), NumRecordedFrames, *NiagaraSkeletalBenchmark::ToJson());
+			const FString FileName = FString::Printf(TEXT("Particles%d_Churn%g_%s.json"), Scenario.NumParticles, Scenario.ChurnRate, Scenario.bAssignComponentsOnParticleID ? TEXT("ParticleID") : TEXT("Index"));
+			const FString FilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("NiagaraSkeletal"), TEXT("Benchmark"), FileName);
+			Test.TestTrue(FString::Printf(TEXT("Wrote %s"), *FilePath), FFileHelper::SaveStringToFile(Json, *FilePath));
+			Test.AddInfo(Json);
+			Component->DestroyComponent();
+		}
+
+		BenchmarkVariable->Set(PreviousBenchmarkValue, ECVF_SetByCode);
+		NiagaraSkeletalBenchmark::Reset();
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		return bSpawned;
+	}
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FNiagaraSkeletalRendererBenchmarkTest, "Niagara.Skeletal.Benchmark.Renderer",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+void FNiagaraSkeletalRendererBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	const int32 ParticleCounts[] = { 100, 1000, 10000 };
+	const float ChurnRates[] = { 0.1f, 1.0f };
+	for (const int32 NumParticles : ParticleCounts)
+	{
+		for (const float ChurnRate : ChurnRates)
+		{
+			for (const bool bAssignComponentsOnParticleID : { false, true })
+			{
+				OutBeautifiedNames.Add(FString::Printf(TEXT("Particles%d Churn%g %s"), NumParticles, ChurnRate, bAssignComponentsOnParticleID ? TEXT("ParticleID") : TEXT("Index")));
+				OutTestCommands.Add(FString::Printf(TEXT("%d %g %d"), NumParticles, ChurnRate, bAssignComponentsOnParticleID ? 1 : 0));
+			}
+		}
+	}
+}
+
+bool FNiagaraSkeletalRendererBenchmarkTest::RunTest(const FString& Parameters)
+{
+	TArray<FString> Args;
+	Parameters.ParseIntoArrayWS(Args);
+	NiagaraSkeletalBenchmarkTests::FScenario Scenario;
+	int32 bAssignComponentsOnParticleID = 1;
+	if (Args.Num() != 3 || !FDefaultValueHelper::ParseInt(Args[0], Scenario.NumParticles) || !FDefaultValueHelper::ParseFloat(Args[1], Scenario.ChurnRate)
+		|| !FDefaultValueHelper::ParseInt(Args[2], bAssignComponentsOnParticleID) || Scenario.NumParticles <= 0 || Scenario.ChurnRate <= 0.0f)
+	{
+		AddError(FString::Printf(TEXT("Expected <NumParticles> <ChurnRate> <AssignOnParticleID>, got '%s'"), *Parameters));
+		return false;
+	}
+	Scenario.bAssignComponentsOnParticleID = bAssignComponentsOnParticleID != 0;
+	return NiagaraSkeletalBenchmarkTests::RunScenario(*this, Scenario);
+}
+
+#endif
@@ -0,0 +1,279 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalSlotEngine.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+#include "NiagaraSkeletalAllocationCounter.h"
+
+namespace NiagaraSkeletalSlotEngineTests
+{
+	// Stands in for a pooled component, remembers what it was set up for and who it was handed to
+	struct FTestEntry
+	{
+		int32 Key = INDEX_NONE;
+		int32 ParticleID = INDEX_NONE;
+	};
+
+	// Replays random particle births, deaths, enable toggles and animation changes through the slot engine the way the renderer drives it,
+	// checking its invariants after every step. Returns false on the first violation
+	static bool RunChurn(FAutomationTestBase& Test, int32 NumParticles, int32 NumTicks, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TNiagaraSkeletalSlotEngine<FTestEntry> Engine;
+		const int32 MaxSlots = FMath::Max(NumParticles * 3 / 4, 1);
+		const int32 NumKeys = 8;
+		Engine.Reserve(MaxSlots);
+
+		TArray<int32> ParticleIDs;
+		TArray<bool> Enabled;
+		TArray<int32> Keys;
+		int32 NextParticleID = 0;
+		uint64 TickCycles = 0;
+		int64 NumParticleTicks = 0;
+
+		for (int32 Tick = 0; Tick < NumTicks; ++Tick)
+		{
+			// churn the particles, the count wanders around the requested one
+			for (int32 ParticleIndex = ParticleIDs.Num() - 1; ParticleIndex >= 0; --ParticleIndex)
+			{
+				if (Random.FRand() < 0.05f)
+				{
+					ParticleIDs.RemoveAtSwap(ParticleIndex, 1, false);
+					Enabled.RemoveAtSwap(ParticleIndex, 1, false);
+					Keys.RemoveAtSwap(ParticleIndex, 1, false);
+				}
+				else if (Random.FRand() < 0.02f)
+				{
+					Enabled[ParticleIndex] = !Enabled[ParticleIndex];
+				}
+				else if (Random.FRand() < 0.02f)
+				{
+					Keys[ParticleIndex] = Random.RandHelper(NumKeys);
+				}
+			}
+			const int32 TargetParticles = Random.RandRange(NumParticles / 2, NumParticles);
+			while (ParticleIDs.Num() < TargetParticles)
+			{
+				ParticleIDs.Add(NextParticleID++);
+				Enabled.Add(Random.FRand() < 0.9f);
+				Keys.Add(Random.RandHelper(NumKeys));
+			}
+
+			// decided up front so the random stream doesn't end up in the timing
+			TArray<bool> InvalidTag;
+			TArray<bool> OverBudget;
+			InvalidTag.SetNumUninitialized(ParticleIDs.Num());
+			OverBudget.SetNumUninitialized(ParticleIDs.Num());
+			for (int32 ParticleIndex = 0; ParticleIndex < ParticleIDs.Num(); ++ParticleIndex)
+			{
+				InvalidTag[ParticleIndex] = Random.FRand() < 0.01f;
+				OverBudget[ParticleIndex] = Random.FRand() < 0.1f;
+			}
+			const bool bTrimAll = Random.FRand() < 0.05f;
+
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			Engine.Reconcile(ParticleIDs, Enabled, [](int32 SlotIndex) {});
+			TickCycles += FPlatformTime::Cycles64() - StartCycles;
+			if (!Test.TestTrue(FString::Printf(TEXT("Invariants after reconcile on tick %d (seed %d)"), Tick, Seed), Engine.CheckInvariants()))
+			{
+				return false;
+			}
+
+			StartCycles = FPlatformTime::Cycles64();
+			int32 NumInUse = 0;
+			for (int32 ParticleIndex = 0; ParticleIndex < ParticleIDs.Num(); ++ParticleIndex)
+			{
+				if (!Enabled[ParticleIndex])
+				{
+					continue;
+				}
+
+				int32 SlotIndex = Engine.FindSlot(ParticleIDs[ParticleIndex]);
+				if (SlotIndex == INDEX_NONE && Engine.NumAssigned() >= MaxSlots)
+				{
+					continue;
+				}
+				if (InvalidTag[ParticleIndex])
+				{
+					if (SlotIndex != INDEX_NONE)
+					{
+						Engine.Release(SlotIndex);
+					}
+					continue;
+				}
+
+				const int32 Key = Keys[ParticleIndex];
+				if (SlotIndex == INDEX_NONE)
+				{
+					SlotIndex = Engine.AcquireFree(Key, MaxSlots);
+					if (OverBudget[ParticleIndex])
+					{
+						if (SlotIndex != INDEX_NONE)
+						{
+							Engine.ReturnUnused(SlotIndex);
+						}
+						continue;
+					}
+					if (SlotIndex == INDEX_NONE)
+					{
+						Engine.AddSlot(SlotIndex);
+					}
+				}
+
+				FTestEntry& Entry = Engine[SlotIndex];
+				if (Entry.Key != Key)
+				{
+					Entry.Key = Key;
+					Engine.SetKey(SlotIndex, Key);
+				}
+				Entry.ParticleID = ParticleIDs[ParticleIndex];
+				Engine.Assign(SlotIndex, ParticleIDs[ParticleIndex]);
+				++NumInUse;
+			}
+			TickCycles += FPlatformTime::Cycles64() - StartCycles;
+			if (!Test.TestTrue(FString::Printf(TEXT("Invariants after assignment on tick %d (seed %d)"), Tick, Seed), Engine.CheckInvariants()))
+			{
+				return false;
+			}
+
+			StartCycles = FPlatformTime::Cycles64();
+			if (NumInUse < Engine.Num())
+			{
+				Engine.TrimUnused(0, [bTrimAll](int32 SlotIndex, FTestEntry& Entry)
+				{
+					return bTrimAll;
+				});
+			}
+			TickCycles += FPlatformTime::Cycles64() - StartCycles;
+			NumParticleTicks += ParticleIDs.Num();
+
+			bool bValid = Engine.CheckInvariants() && Engine.NumAssigned() == NumInUse && Engine.NumAssigned() <= MaxSlots && Engine.Num() <= MaxSlots;
+			for (int32 ParticleIndex = 0; bValid && ParticleIndex < ParticleIDs.Num(); ++ParticleIndex)
+			{
+				const int32 SlotIndex = Engine.FindSlot(ParticleIDs[ParticleIndex]);
+				if (SlotIndex != INDEX_NONE)
+				{
+					// only enabled particles hold slots, set up for what they show
+					bValid = Enabled[ParticleIndex] && Engine[SlotIndex].ParticleID == ParticleIDs[ParticleIndex]
+						&& Engine[SlotIndex].Key == Keys[ParticleIndex] && Engine.GetKey(SlotIndex) == Keys[ParticleIndex];
+				}
+			}
+			if (!Test.TestTrue(FString::Printf(TEXT("Invariants after trimming on tick %d (seed %d)"), Tick, Seed), bValid))
+			{
+				return false;
+			}
+		}
+
+		const double NsPerParticle = NumParticleTicks > 0 ? FPlatformTime::ToMilliseconds64(TickCycles) * 1.0e6 / double(NumParticleTicks) : 0.0;
+		Test.AddInfo(FString::Printf(TEXT("%d ticks of up to %d particles (seed %d), %.1f ns per particle"), NumTicks, NumParticles, Seed, NsPerParticle));
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalSlotEngineChurnTest, "Niagara.Skeletal.SlotEngine.Churn",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FNiagaraSkeletalSlotEngineChurnTest::RunTest(const FString& Parameters)
+{
+	const int32 ParticleCounts[] = { 1, 100, 1000, 10000 };
+	for (const int32 NumParticles : ParticleCounts)
+	{
+		for (int32 Seed = 0; Seed < 4; ++Seed)
+		{
+			if (!NiagaraSkeletalSlotEngineTests::RunChurn(*this, NumParticles, NumParticles >= 10000 ? 100 : 500, Seed))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalSlotEngineSteadyAllocationsTest, "Niagara.Skeletal.SlotEngine.SteadyAllocations",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+// A full pool whose particles keep dying and being replaced, the renderer's steady state with bAssignComponentsOnParticleID. Once every key
+// has been seen, reconciling and handing the freed slots to the newborn particles must not touch the heap
+bool FNiagaraSkeletalSlotEngineSteadyAllocationsTest::RunTest(const FString& Parameters)
+{
+	using namespace NiagaraSkeletalSlotEngineTests;
+
+	const int32 NumParticles = 1000;
+	const int32 NumKeys = 4;
+	TNiagaraSkeletalSlotEngine<FTestEntry> Engine;
+	Engine.Reserve(NumParticles);
+
+	TArray<int32> ParticleIDs;
+	TArray<bool> Enabled;
+	ParticleIDs.SetNumUninitialized(NumParticles);
+	Enabled.Init(true, NumParticles);
+	for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+	{
+		int32 SlotIndex;
+		FTestEntry& Entry = Engine.AddSlot(SlotIndex);
+		Entry.Key = ParticleIndex % NumKeys;
+		Entry.ParticleID = ParticleIndex;
+		Engine.SetKey(SlotIndex, Entry.Key);
+		ParticleIDs[ParticleIndex] = ParticleIndex;
+		Engine.Assign(SlotIndex, ParticleIndex);
+	}
+
+	// a tenth of the particles is replaced every tick, the first few ticks see every free list once
+	int32 NextParticleID = NumParticles;
+	const int32 NumWarmupTicks = 4;
+	for (int32 Tick = 0; Tick < NumWarmupTicks + 100; ++Tick)
+	{
+		int32 NumUnassigned = 0;
+		int32 NumReconfigured = 0;
+		int64 NumAllocations = 0;
+		{
+			FNiagaraSkeletalScopedAllocationCounter AllocationCounter;
+			for (int32 ParticleIndex = Tick % 10; ParticleIndex < NumParticles; ParticleIndex += 10)
+			{
+				ParticleIDs[ParticleIndex] = NextParticleID++;
+			}
+			Engine.Reconcile(ParticleIDs, Enabled, [](int32 SlotIndex) {});
+
+			for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+			{
+				if (Engine.FindSlot(ParticleIDs[ParticleIndex]) != INDEX_NONE)
+				{
+					continue;
+				}
+				const int32 Key = ParticleIndex % NumKeys;
+				const int32 SlotIndex = Engine.AcquireFree(Key, NumParticles);
+				if (SlotIndex == INDEX_NONE)
+				{
+					++NumUnassigned;
+					continue;
+				}
+				if (Engine.GetKey(SlotIndex) != Key)
+				{
+					++NumReconfigured;
+					Engine[SlotIndex].Key = Key;
+					Engine.SetKey(SlotIndex, Key);
+				}
+				Engine[SlotIndex].ParticleID = ParticleIDs[ParticleIndex];
+				Engine.Assign(SlotIndex, ParticleIDs[ParticleIndex]);
+			}
+			NumAllocations = AllocationCounter.GetNumAllocations();
+		}
+
+		TestEqual(FString::Printf(TEXT("Particles without a slot on tick %d"), Tick), NumUnassigned, 0);
+		TestEqual(FString::Printf(TEXT("Slots handed to another key on tick %d"), Tick), NumReconfigured, 0);
+		if (Tick >= NumWarmupTicks)
+		{
+			TestEqual(FString::Printf(TEXT("Heap allocations on tick %d"), Tick), NumAllocations, int64(0));
+		}
+		if (!TestTrue(FString::Printf(TEXT("Invariants on tick %d"), Tick), Engine.CheckInvariants()))
+		{
+			return false;
+		}
+	}
+	TestEqual(TEXT("Pool size"), Engine.Num(), NumParticles);
+	return true;
+}
+
+#endif
@@ -0,0 +1,60 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalSlotTable.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+#include "NiagaraSkeletalAllocationCounter.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalSlotTableSteadyReconcileTest, "Niagara.Skeletal.SlotTable.SteadyReconcile",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+// Once every particle holds a slot, reconciling the same IDs tick after tick must neither allocate nor move anyone
+bool FNiagaraSkeletalSlotTableSteadyReconcileTest::RunTest(const FString& Parameters)
+{
+	const int32 NumParticles = 1000;
+	FNiagaraSkeletalSlotTable SlotTable;
+	SlotTable.Reserve(NumParticles);
+	for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+	{
+		// sparse IDs, like the ones of a system that has been spawning and killing particles for a while
+		SlotTable.Assign(SlotTable.AddSlot(), ParticleIndex * 7 + 3);
+	}
+
+	const int64 AllocatedSize = SlotTable.GetAllocatedSize();
+	const int32 NumSlots = SlotTable.Num();
+	for (int32 Tick = 0; Tick < 100; ++Tick)
+	{
+		// only the reconcile is counted, the checks below format strings
+		int32 NumMoved = 0;
+		int32 NumReleased = 0;
+		int64 NumAllocations = 0;
+		{
+			FNiagaraSkeletalScopedAllocationCounter AllocationCounter;
+			SlotTable.BeginReconcile();
+			for (int32 ParticleIndex = 0; ParticleIndex < NumParticles; ++ParticleIndex)
+			{
+				const int32 SlotIndex = SlotTable.FindSlot(ParticleIndex * 7 + 3);
+				if (SlotIndex != ParticleIndex)
+				{
+					++NumMoved;
+					continue;
+				}
+				SlotTable.MarkAlive(SlotIndex);
+			}
+			SlotTable.ReleaseStale([&NumReleased](int32 SlotIndex) { ++NumReleased; });
+			NumAllocations = AllocationCounter.GetNumAllocations();
+		}
+
+		TestEqual(TEXT("Heap allocations"), NumAllocations, int64(0));
+		TestEqual(TEXT("Particles that moved slot"), NumMoved, 0);
+		TestEqual(TEXT("Slots released"), NumReleased, 0);
+		TestEqual(TEXT("Slots assigned"), SlotTable.NumAssigned(), NumParticles);
+		TestEqual(TEXT("Slot count"), SlotTable.Num(), NumSlots);
+		TestEqual(TEXT("Allocated size"), int64(SlotTable.GetAllocatedSize()), AllocatedSize);
+		TestTrue(TEXT("Invariants"), SlotTable.CheckInvariants());
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,195 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#include "NiagaraSkeletalVertexAnimation.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+#if WITH_EDITOR
+#include "Animation/AnimData/IAnimationDataController.h"
+#include "Animation/AnimSequence.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/Texture2D.h"
+#include "Rendering/SkeletalMeshLODModel.h"
+#include "Rendering/SkeletalMeshModel.h"
+#include "StaticMeshCompiler.h"
+#endif
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalVATTextureLayoutTest, "Niagara.Skeletal.VertexAnimation.TextureLayout",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FNiagaraSkeletalVATTextureLayoutTest::RunTest(const FString& Parameters)
+{
+	using namespace NiagaraSkeletalVertexAnimation;
+
+	struct FCase
+	{
+		int32 NumVertices;
+		int32 TextureWidth;
+		int32 RowsPerFrame;
+	};
+	const FCase Cases[] =
+	{
+		{ 0, 1, 1 },
+		{ 1, 1, 1 },
+		{ 500, 500, 1 },
+		{ MaxTextureSize, MaxTextureSize, 1 },
+		{ MaxTextureSize + 1, MaxTextureSize, 2 },
+		{ MaxTextureSize * 3, MaxTextureSize, 3 },
+	};
+	for (const FCase& Case : Cases)
+	{
+		int32 TextureWidth, RowsPerFrame;
+		ComputeTextureLayout(Case.NumVertices, TextureWidth, RowsPerFrame);
+		TestEqual(FString::Printf(TEXT("Width for %d vertices"), Case.NumVertices), TextureWidth, Case.TextureWidth);
+		TestEqual(FString::Printf(TEXT("Rows per frame for %d vertices"), Case.NumVertices), RowsPerFrame, Case.RowsPerFrame);
+		TestTrue(FString::Printf(TEXT("Every one of %d vertices has a texel"), Case.NumVertices), TextureWidth * RowsPerFrame >= Case.NumVertices);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalVATSampleAnimationTest, "Niagara.Skeletal.VertexAnimation.SampleAnimation",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FNiagaraSkeletalVATSampleAnimationTest::RunTest(const FString& Parameters)
+{
+	using namespace NiagaraSkeletalVertexAnimation;
+
+	// 1 second at 10 frames per second, the closing frame at 1s makes 11
+	FNiagaraSkeletalVATAnimationRange Range;
+	Range.StartFrame = 20;
+	Range.NumFrames = 11;
+	Range.Length = 1.0f;
+
+	struct FCase
+	{
+		float AnimTime;
+		int32 FrameA;
+		int32 FrameB;
+		float Blend;
+	};
+	const FCase Cases[] =
+	{
+		{ 0.0f, 20, 21, 0.0f },
+		{ 0.25f, 22, 23, 0.5f },
+		{ 0.999f, 29, 30, 0.99f },
+		// looping, in both directions
+		{ 1.25f, 22, 23, 0.5f },
+		{ -0.75f, 22, 23, 0.5f },
+	};
+	for (const FCase& Case : Cases)
+	{
+		int32 FrameA, FrameB;
+		float Blend;
+		SampleAnimation(Range, Case.AnimTime, FrameA, FrameB, Blend);
+		TestEqual(FString::Printf(TEXT("Frame A at %.3fs"), Case.AnimTime), FrameA, Case.FrameA);
+		TestEqual(FString::Printf(TEXT("Frame B at %.3fs"), Case.AnimTime), FrameB, Case.FrameB);
+		TestEqual(FString::Printf(TEXT("Blend at %.3fs"), Case.AnimTime), Blend, Case.Blend, 1.0e-3f);
+	}
+
+	// a single frame, or an animation without length, holds its first frame
+	FNiagaraSkeletalVATAnimationRange StaticRange;
+	StaticRange.StartFrame = 5;
+	StaticRange.NumFrames = 1;
+	StaticRange.Length = 0.0f;
+	int32 FrameA, FrameB;
+	float Blend;
+	SampleAnimation(StaticRange, 3.0f, FrameA, FrameB, Blend);
+	TestEqual(TEXT("Static frame A"), FrameA, 5);
+	TestEqual(TEXT("Static frame B"), FrameB, 5);
+	TestEqual(TEXT("Static blend"), Blend, 0.0f);
+	return true;
+}
+
+#if WITH_EDITOR
+namespace NiagaraSkeletalVATTests
+{
+	// A sequence without any bone track, it holds the mesh's rest pose for its whole length
+	static UAnimSequence* CreateRestPoseSequence(USkeletalMesh* SkeletalMesh, const FFrameRate& FrameRate, int32 NumFrames)
+	{
+		UAnimSequence* Sequence = NewObject<UAnimSequence>(GetTransientPackage(), NAME_None, RF_Transient);
+		Sequence->SetSkeleton(SkeletalMesh->GetSkeleton());
+		IAnimationDataController& Controller = Sequence->GetController();
+		Controller.InitializeModel();
+		Controller.OpenBracket(FText::FromString(TEXT("Rest pose sequence")), false);
+		Controller.SetFrameRate(FrameRate, false);
+		Controller.SetNumberOfFrames(FFrameNumber(NumFrames), false);
+		Controller.NotifyPopulated();
+		Controller.CloseBracket(false);
+		return Sequence;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNiagaraSkeletalVATBakeTest, "Niagara.Skeletal.VertexAnimation.Bake",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Bakes two short sequences of the engine's skeletal cube and checks the layout of the result, and that the first frame is the rest pose
+bool FNiagaraSkeletalVATBakeTest::RunTest(const FString& Parameters)
+{
+	using namespace NiagaraSkeletalVertexAnimation;
+
+	USkeletalMesh* SkeletalMesh = LoadObject<USkeletalMesh>(nullptr, TEXT("/Engine/EngineMeshes/SkeletalCube.SkeletalCube"));
+	if (!TestNotNull(TEXT("Skeletal mesh"), SkeletalMesh) || !TestNotNull(TEXT("Skeleton"), SkeletalMesh->GetSkeleton()))
+	{
+		return false;
+	}
+	const int32 NumLODVertices = SkeletalMesh->GetImportedModel()->LODModels[0].NumVertices;
+
+	// half a second and a second at 10 frames per second, each baked with its closing frame
+	const float FrameRate = 10.0f;
+	TArray<TObjectPtr<UAnimationAsset>> Animations;
+	Animations.Add(NiagaraSkeletalVATTests::CreateRestPoseSequence(SkeletalMesh, FFrameRate(10, 1), 5));
+	Animations.Add(NiagaraSkeletalVATTests::CreateRestPoseSequence(SkeletalMesh, FFrameRate(10, 1), 10));
+
+	FNiagaraSkeletalVATBakeData Data;
+	if (!TestTrue(TEXT("Baked"), Bake(SkeletalMesh, Animations, FrameRate, false, Data)))
+	{
+		return false;
+	}
+
+	int32 TextureWidth, RowsPerFrame;
+	ComputeTextureLayout(NumLODVertices, TextureWidth, RowsPerFrame);
+	TestEqual(TEXT("Vertex count"), Data.NumVertices, NumLODVertices);
+	TestEqual(TEXT("Texture width"), Data.TextureWidth, TextureWidth);
+	TestEqual(TEXT("Rows per frame"), Data.RowsPerFrame, RowsPerFrame);
+	TestEqual(TEXT("Frame count"), Data.NumFrames, 17);
+	TestEqual(TEXT("Position texels"), Data.PositionTexels.Num(), Data.TextureWidth * Data.RowsPerFrame * Data.NumFrames * 4);
+	TestEqual(TEXT("Normal texels"), Data.NormalTexels.Num(), Data.TextureWidth * Data.RowsPerFrame * Data.NumFrames);
+
+	if (TestEqual(TEXT("Animation ranges"), Data.Animations.Num(), 2))
+	{
+		TestEqual(TEXT("First animation start"), Data.Animations[0].StartFrame, 0);
+		TestEqual(TEXT("First animation frames"), Data.Animations[0].NumFrames, 6);
+		TestEqual(TEXT("First animation length"), Data.Animations[0].Length, 0.5f, 1.0e-4f);
+		TestEqual(TEXT("Second animation start"), Data.Animations[1].StartFrame, 6);
+		TestEqual(TEXT("Second animation frames"), Data.Animations[1].NumFrames, 11);
+		TestEqual(TEXT("Second animation length"), Data.Animations[1].Length, 1.0f, 1.0e-4f);
+	}
+
+	// the texels hold offsets from the rest pose, which the first frame of a rest pose sequence has none of
+	float MaxOffset = 0.0f;
+	for (int32 VertexIndex = 0; VertexIndex < Data.NumVertices; ++VertexIndex)
+	{
+		for (int32 Component = 0; Component < 3; ++Component)
+		{
+			MaxOffset = FMath::Max(MaxOffset, FMath::Abs(float(Data.PositionTexels[VertexIndex * 4 + Component])));
+		}
+	}
+	TestTrue(FString::Printf(TEXT("Frame 0 is the rest pose, largest offset %f"), MaxOffset), MaxOffset < 1.0e-2f);
+
+	FNiagaraSkeletalVertexAnimationBake AssetBake;
+	if (!TestTrue(TEXT("Baked assets"), BakeAssets(GetTransientPackage(), SkeletalMesh, Animations, FrameRate, false, AssetBake)))
+	{
+		return false;
+	}
+	// the mesh build may still be running on a worker, the texture sizes are read from their source so they don't need to be built at all
+	FStaticMeshCompilingManager::Get().FinishCompilation({ AssetBake.StaticMesh.Get() });
+	TestEqual(TEXT("Static mesh vertex count"), AssetBake.StaticMesh->GetNumVertices(0), NumLODVertices);
+	TestEqual(TEXT("Position texture width"), int32(AssetBake.PositionTexture->Source.GetSizeX()), Data.TextureWidth);
+	TestEqual(TEXT("Position texture height"), int32(AssetBake.PositionTexture->Source.GetSizeY()), Data.RowsPerFrame * Data.NumFrames);
+	TestEqual(TEXT("Baked animation ranges"), AssetBake.Animations.Num(), 2);
+	return true;
+}
+#endif
+
+#endif
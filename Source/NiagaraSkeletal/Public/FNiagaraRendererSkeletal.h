@@ -1,24 +1,92 @@
 ﻿#pragma once
+#include "ConvexVolume.h"
 #include "Engine/EngineTypes.h"
+#include "NiagaraDataSetAccessor.h"
 #include "NiagaraRenderer.h"
+#include "NiagaraSkeletalBenchmark.h"
+#include "NiagaraSkeletalSlotEngine.h"
 
+class UInstancedStaticMeshComponent;
 class UNiagaraSkeletalRendererProperties;
+struct FNiagaraSkeletalCustomDataLayout;
 
 
 
-struct FNiagaraParticleData
+// Readers for every attribute the renderer reads, bound to the data set's current buffer when they are created
+struct FNiagaraSkeletalParticleReaders
+{
+	FNiagaraSkeletalParticleReaders(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraDataSet& Data);
+
+	FNiagaraDataSetReaderInt32<FNiagaraBool> Enabled;
+	FNiagaraDataSetReaderFloat<FNiagaraPosition> Position;
+	FNiagaraDataSetReaderFloat<FVector3f> Rotate;
+	FNiagaraDataSetReaderFloat<FVector3f> Scale;
+	FNiagaraDataSetReaderFloat<float> SkeletalAnimTime;
+	FNiagaraDataSetReaderInt32<int32> VisTag;
+	FNiagaraDataSetReaderInt32<int32> AnimIndex;
+	FNiagaraDataSetReaderInt32<int32> UniqueID;
+	FNiagaraDataSetReaderFloat<float> Priority;
+	FNiagaraDataSetReaderFloat<FVector2f> AnimBlendParameters;
+
+	// custom data is read straight from the buffer's float components
+	const FNiagaraDataBuffer* DataBuffer;
+	TConstArrayView<FNiagaraSkeletalCustomDataLayout> CustomDataLayouts;
+	int32 NumCustomDataFloats;
+};
+
+// Columnar copy of every attribute the renderer reads, extracted once per tick for the whole data buffer
+struct FNiagaraSkeletalParticleBatch
 {
 public:
-	FNiagaraParticleData(const UNiagaraSkeletalRendererProperties* Properties,FNiagaraDataSet& Data,int32 ParticleIndex);
-	FNiagaraPosition Position;
-	FVector3f Rotate ;
-	FVector3f Scale ;
-	float SkeletalAnimTime ;
-	int  VisTag;
-	int AnimIndex ;
-	int32 UniqueID ;
-	bool Enabled;
+	// With bParallel every attribute column is copied by its own worker, either way the batch is complete when this returns
+	void Extract(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraDataSet& Data, int32 NumInstances, bool bParallel = false);
+	void Extract(const FNiagaraSkeletalParticleReaders& Readers, int32 NumInstances, bool bParallel = false);
+	int32 Num() const { return NumParticles; }
+	SIZE_T GetAllocatedSize() const;
+
+	TArray<FNiagaraPosition> Position;
+	TArray<FVector3f> Rotate;
+	TArray<FVector3f> Scale;
+	TArray<float> SkeletalAnimTime;
+	TArray<int32> VisTag;
+	TArray<int32> AnimIndex;
+	TArray<int32> UniqueID;
+	TArray<bool> Enabled;
+	TArray<float> Priority;
+	TArray<FVector2f> AnimBlendParameters;
+	// NumCustomDataFloats per particle, packed in the order of the properties' CustomDataLayouts
+	TArray<float> CustomData;
+
+private:
+	int32 NumParticles = 0;
+};
+
+// Particle positions are in simulation space, which for local space emitters is relative to the system instance.
+// Components attached to the system take them as is, anything tested against views or put in an absolute primitive needs the world position
+struct FNiagaraSkeletalSimulationSpace
+{
+	FNiagaraSkeletalSimulationSpace(const FNiagaraEmitterInstance* Emitter);
+
+	FVector ToSimulation(const FNiagaraPosition& Position) const { return LwcConverter.ConvertSimulationPositionToWorld(Position); }
+	FVector ToWorld(const FNiagaraPosition& Position) const { return bLocalSpace ? LocalToWorld.TransformPosition(ToSimulation(Position)) : ToSimulation(Position); }
+
+	FNiagaraLWCConverter LwcConverter;
+	FTransform LocalToWorld;
+	bool bLocalSpace;
+};
+
+// PlayRate playback, how fast a particle's anim time moves. Its time is recorded every tick, also while the component follows another's pose,
+// so the rate is already right on the tick the component takes over as a pose leader
+struct FNiagaraSkeletalPlayRateTracker
+{
+	// ParticleAnimTime is wrapped into the animation. 1 until a time was recorded
+	float GetPlayRate(float ParticleAnimTime, float AnimLength, float DeltaSeconds) const;
+	void Record(float ParticleAnimTime);
+	void Reset();
 
+private:
+	float LastParticleAnimTime = 0.0f;
+	bool bHasLastTime = false;
 };
 
 
@@ -41,17 +109,178 @@ private:
 	{
 		TWeakObjectPtr<USkeletalMeshComponent> Component;
 		double LastActiveTime = 0.0;
-		int32 LastAssignedToParticleID = -1;
+
+		// state last pushed to the component, so unchanged components can skip the engine calls
+		FVector AppliedPosition = FVector::ZeroVector;
+		FVector3f AppliedRotate = FVector3f::ZeroVector;
+		FVector3f AppliedScale = FVector3f::OneVector;
+		float AppliedAnimTime = 0.0f;
+		// PlayRate playback, the particle's anim time last tick and the rate the component was last set to play at
+		FNiagaraSkeletalPlayRateTracker PlayRateTracker;
+		float AppliedPlayRate = 1.0f;
+		bool bHasAppliedState = false;
+		// the component this one currently follows the pose of, when sharing poses
+		TWeakObjectPtr<USkeletalMeshComponent> AppliedPoseLeader;
+		// index into the properties' AnimationLODs the component is set up for
+		int32 AppliedAnimationLOD = INDEX_NONE;
+		// when the particle owning this entry left the view frustums, negative while it's visible
+		double CulledTime = -1.0;
+		// tick disabled because the particle is off screen
+		bool bCullSuspended = false;
+		// SkeletalMeshes entry and version of its materials last set on the component
+		int32 AppliedMaterialEntry = INDEX_NONE;
+		uint32 AppliedMaterialVersion = 0;
+		// custom primitive data last written, packed like the particle batch's
+		TArray<float> AppliedCustomData;
 	};
 	
 
 	// if the niagara component is not attached to an actor, we need to spawn and keep track of a temporary actor
 	TWeakObjectPtr<AActor> SpawnedOwner;
+	AActor* FindOrSpawnOwner(USceneComponent* AttachComponent);
 
 	void ResetComponentPool(bool bResetOwner);
-	// all of the spawned components
-	TArray<FComponentPoolEntry> ComponentPool;
+	// hands the component to the world pool when allowed, destroys it otherwise. Returns whether it was destroyed
+	static bool ReleaseComponent(USkeletalMeshComponent* Component, bool bUseWorldPool);
+	// components released outside a tick go straight to the stats and the benchmark recorder, no tick is left to publish them
+	static void PublishReleaseCounters(const FNiagaraSkeletalTickCounters& ReleaseCounters);
+	bool bUseWorldComponentPool = false;
+	// all of the spawned components, and which particle each is assigned to. Assignments persist between ticks when assigning on particle ID
+	TNiagaraSkeletalSlotEngine<FComponentPoolEntry> ComponentPool;
+
+	void DeactivatePoolEntry(int32 PoolIndex);
+	int32 AddPoolEntry(USkeletalMeshComponent* SkeletalMeshComponent);
+	USkeletalMeshComponent* CreateComponent(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, USkeletalMesh* SkeletalMesh, int32 AnimIndex);
+	void PrewarmComponentPool(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent);
+
+	// the pool is prewarmed when the render state is created, or on the first tick after it was last reset
+	bool bPoolPrewarmed = false;
+	// What happened to the pool since the last tick was published, to the stats group and the CSV profiler once the tick is done
+	FNiagaraSkeletalTickCounters TickCounters;
+	// pool memory this renderer last added to the memory stat
+	int64 ReportedPoolMemory = 0;
+	void PublishTickCounters(int32 NumLiveComponents);
+	// heap held by the renderer's own containers, the benchmark records how much it grows per tick
+	int64 GetContainerAllocatedSize() const;
+
+	// play length of every Animations entry, PlayRate playback wraps anim times into it
+	TArray<float> AnimationLengths;
+
+	// Components are pooled per (SkeletalMeshes entry, animation), the key of a sub-pool in the slot table. With AnimInstance playback any
+	// component plays any animation, so only the entry matters
+	static int32 ClampAnimIndex(const UNiagaraSkeletalRendererProperties* Properties, int32 AnimIndex);
+	static int32 GetPoolKey(const UNiagaraSkeletalRendererProperties* Properties, int32 VisTag, int32 AnimIndex);
+	static bool IsComponentConfigured(const UNiagaraSkeletalRendererProperties* Properties, const USkeletalMeshComponent* Component, const USkeletalMesh* SkeletalMesh, int32 AnimIndex);
+	// AnimInstance playback, gives the component the particle driven anim instance and the animations it indexes into
+	static void SetupAnimInstance(const UNiagaraSkeletalRendererProperties* Properties, USkeletalMeshComponent* Component);
+	// Fallback when no component of the right sub-pool is free, only touches the mesh or animation that differs
+	void ReconfigurePoolEntry(const UNiagaraSkeletalRendererProperties* Properties, int32 PoolIndex, USkeletalMesh* SkeletalMesh, int32 AnimIndex);
+
+	// Work for one assigned component, filled in parallel then applied on the game thread
+	struct FComponentUpdate
+	{
+		USkeletalMeshComponent* Component = nullptr;
+		int32 ParticleIndex = INDEX_NONE;
+		int32 PoolIndex = INDEX_NONE;
+		FTransform Transform;
+		float AnimTime = 0.0f;
+		// component whose pose this one follows this tick, null when it evaluates its own
+		USkeletalMeshComponent* PoseLeader = nullptr;
+		int32 AnimationLOD = INDEX_NONE;
+		bool bTransformDirty = false;
+		bool bAnimTimeDirty = false;
+		bool bCustomDataDirty = false;
+		// PlayRate playback, the component plays at PlayRate and gets seeked when it drifted too far from AnimTime. ParticleAnimTime is the
+		// particle's own wrapped time, which differs from AnimTime for followers and quantized leaders
+		float ParticleAnimTime = 0.0f;
+		float PlayRate = 1.0f;
+		bool bPlayRateDirty = false;
+		bool bCheckDrift = false;
+		// what the animation budget allocator ranks the component by
+		float Significance = 1.0f;
+	};
+	TArray<FComponentUpdate> ComponentUpdates;
+
+	// Picks one leader per (mesh, anim index, quantized anim time) among this tick's updates and points the others at it
+	void AssignPoseLeaders(const UNiagaraSkeletalRendererProperties* Properties);
+	using FPoseKey = TTuple<const USkeletalMesh*, int32, int32>;
+	TMap<FPoseKey, USkeletalMeshComponent*> PoseLeaders;
+
+	// views of the last rendered frame, gathered once per tick for the priority and animation LOD selection
+	TArray<FVector> ViewLocations;
+
+	// frustums of the local players' cameras, and whether each particle touches any of them this tick
+	TArray<FConvexVolume> ViewFrustums;
+	TArray<bool> ParticleVisible;
+	bool ComputeParticleVisibility(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraSkeletalSimulationSpace& SimulationSpace, UWorld* World);
+	// keeps the culled particle's slot with the component suspended, until the release delay runs out
+	void SuspendCulledPoolEntry(const UNiagaraSkeletalRendererProperties* Properties, int32 PoolIndex, double CurrentTime);
+
+	// When over the component limit, fills SelectedParticles with the highest priority particles in buffer order, frees the slots of the others and returns true
+	bool SelectPriorityParticles(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraSkeletalSimulationSpace& SimulationSpace, bool bCullParticles);
+	struct FParticlePriority
+	{
+		float Score;
+		int32 ParticleIndex;
+	};
+	TArray<FParticlePriority> ParticlePriorities;
+	TArray<int32> SelectedParticles;
+	int32 SelectAnimationLOD(const UNiagaraSkeletalRendererProperties* Properties, const FVector& Position, float Radius) const;
+	static void ApplyAnimationLOD(USkeletalMeshComponent* Component, const FNiagaraSkeletalAnimationLOD* AnimationLOD);
+	float GetClosestViewDistance(const FVector& Position) const;
+
+	// Budgeted components are only registered with the animation budget allocator while a particle shows them, so parked and suspended ones take no budget
+	static UClass* GetComponentClass(const UNiagaraSkeletalRendererProperties* Properties);
+	static void UnregisterFromBudget(USkeletalMeshComponent* Component);
+
+	// per particle attributes for the current tick, kept around so the arrays are only reallocated when the particle count grows
+	FNiagaraSkeletalParticleBatch ParticleBatch;
+
+	// Baked render modes, every particle of a SkeletalMeshes entry is an instance of that entry's baked static mesh so there is one primitive per mesh
+	struct FInstancedMeshEntry
+	{
+		TWeakObjectPtr<UInstancedStaticMeshComponent> Component;
+		// rebuilt every tick, kept to avoid reallocating
+		TArray<FTransform> InstanceTransforms;
+		TArray<float> InstanceCustomData;
+		// what the component was last given, swapped with the ones above once applied so unchanged instances aren't sent again
+		TArray<FTransform> AppliedTransforms;
+		TArray<float> AppliedCustomData;
+	};
+	TArray<FInstancedMeshEntry> InstancedMeshes;
+	// scratch for the instanced mesh component calls that only take whole arrays
+	TArray<int32> InstancesToRemove;
+	TArray<FTransform> InstanceTransformsToSend;
+
+	// returns how many of the instanced mesh components show particles
+	int32 TickInstancedMeshes(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, bool bIsRendererEnabled);
+	UInstancedStaticMeshComponent* CreateInstancedMeshComponent(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter, USceneComponent* AttachComponent, int32 MeshIndex);
+	// returns how many components were destroyed
+	int32 ResetInstancedMeshes();
+
+	// Range of BaseMaterials_GT holding each SkeletalMeshes entry's materials, in the order GetUsedMaterials reports them.
+	// Every component showing an entry shares these materials, the version is bumped whenever one of them changes
+	struct FMeshMaterials
+	{
+		int32 FirstMaterial = 0;
+		int32 NumMaterials = 0;
+		uint32 Version = 1;
+		// override materials bound to user parameters as last resolved, null for slots that aren't bound
+		TArray<TWeakObjectPtr<UMaterialInterface>> BoundOverrides;
+		// mesh the range was laid out for, a mesh bound later may have a different set of slots
+		TWeakObjectPtr<USkeletalMesh> LayoutMesh;
+	};
+	TArray<FMeshMaterials> MeshMaterials;
+	// picks up user parameter bound overrides that changed and pushes the material parameter bindings, once per tick for all components
+	void UpdateMeshMaterials(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter);
+	void SetSkeletalMaterials(FComponentPoolEntry& PoolEntry, USkeletalMeshComponent* SkeletalMeshComponent, int32 MeshIndex);
 
-	void SetSkeletalMaterials(const UNiagaraSkeletalRendererProperties* Properties,USkeletalMeshComponent* SkeletalMeshComponent,const FNiagaraEmitterInstance* Emitter,FNiagaraParticleData* PerParticleData);
+	// Mesh of every SkeletalMeshes entry with user parameter bindings resolved, indexed by VisTag. User parameter objects are kept alive by the
+	// parameter store, so raw pointers are fine for the tick they are resolved in
+	TArray<USkeletalMesh*> ResolvedMeshes;
+	// with no entry bound to a user parameter the table is only filled once
+	bool bHasBoundMeshes = false;
+	void ResolveSkeletalMeshes(const UNiagaraSkeletalRendererProperties* Properties, const FNiagaraEmitterInstance* Emitter);
+	USkeletalMesh* GetResolvedMesh(int32 VisTag) const { return ResolvedMeshes.IsValidIndex(VisTag) ? ResolvedMeshes[VisTag] : nullptr; }
 	
 };
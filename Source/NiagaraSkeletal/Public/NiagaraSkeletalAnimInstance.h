@@ -0,0 +1,97 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "Animation/BlendSpace.h"
+
+#include "NiagaraSkeletalAnimInstance.generated.h"
+
+class UAnimationAsset;
+
+// What the renderer hands a component's anim instance for its particle every tick
+struct FNiagaraSkeletalAnimState
+{
+	// index into the renderer's Animations
+	int32 AnimIndex = 0;
+	float AnimTime = 0.0f;
+	// blend space input, ignored by sequences
+	FVector2f BlendParameters = FVector2f::ZeroVector;
+};
+
+/**
+ * Evaluates the particle's animation on the animation worker threads. The game thread only copies the latest particle state over in PreUpdate,
+ * switching animation entry crossfades between them and blend spaces are sampled at the particle's blend parameters, all from the proxy.
+ */
+USTRUCT()
+struct FNiagaraSkeletalAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FNiagaraSkeletalAnimInstanceProxy() = default;
+	FNiagaraSkeletalAnimInstanceProxy(UAnimInstance* InAnimInstance)
+		: FAnimInstanceProxy(InAnimInstance)
+	{
+	}
+
+protected:
+	//FAnimInstanceProxy Interface
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+	virtual bool Evaluate(FPoseContext& Output) override;
+	//FAnimInstanceProxy Interface END
+
+private:
+	struct FPlayer
+	{
+		int32 AnimIndex = INDEX_NONE;
+		float AnimTime = 0.0f;
+		FVector2f BlendParameters = FVector2f::ZeroVector;
+		// blend space sampling state, kept between evaluations so the triangulation lookup starts from the last hit
+		TArray<FBlendSampleData> BlendSamples;
+		int32 CachedTriangulationIndex = INDEX_NONE;
+	};
+	void EvaluatePlayer(FPlayer& Player, FPoseContext& Output);
+
+	// copied from the anim instance on the game thread, the instance keeps the assets referenced
+	TArray<UAnimationAsset*> Animations;
+	float CrossfadeDuration = 0.0f;
+	FNiagaraSkeletalAnimState State;
+	bool bSnap = true;
+
+	// the particle's animation, and the one it is fading out of while CrossfadeAlpha hasn't reached one
+	FPlayer Current;
+	FPlayer Previous;
+	float CrossfadeAlpha = 1.0f;
+};
+
+/** Anim instance the skeletal renderer gives its components with AnimInstance playback, see FNiagaraSkeletalAnimInstanceProxy. */
+UCLASS(Transient, NotBlueprintable, MinimalAPI)
+class UNiagaraSkeletalAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+public:
+	// Animations the particles index into and how long switching between them takes, set when the component is set up for the renderer
+	void SetAnimations(TConstArrayView<TObjectPtr<UAnimationAsset>> InAnimations, float InCrossfadeDuration);
+	// The particle's state for the next update. bSnap skips the crossfade, for a particle that only just picked the component up
+	void SetParticleState(const FNiagaraSkeletalAnimState& InState, bool bSnap);
+
+protected:
+	//UAnimInstance Interface
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+	//UAnimInstance Interface END
+
+private:
+	friend struct FNiagaraSkeletalAnimInstanceProxy;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UAnimationAsset>> Animations;
+
+	float CrossfadeDuration = 0.0f;
+	FNiagaraSkeletalAnimState State;
+	bool bSnapPending = true;
+	// the proxy only copies the animations again after they changed
+	bool bAnimationsDirty = true;
+};
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+
+// What happened to a skeletal renderer's component pool during one tick
+struct FNiagaraSkeletalTickCounters
+{
+	// particles that took a free component already set up for them
+	int32 NumPoolHits = 0;
+	// particles that needed a component created or reconfigured
+	int32 NumPoolMisses = 0;
+	int32 NumCreated = 0;
+	// pooled components that had to be switched to another mesh or animation
+	int32 NumReconfigured = 0;
+	int32 NumDestroyed = 0;
+	// particles that wanted a component but were over ComponentCountLimit
+	int32 NumDropped = 0;
+	// particles that wanted a new component but were over the creation budget
+	int32 NumPending = 0;
+};
+
+// Opt in recording of every skeletal renderer's phase timings and pool counters for benchmark runs, e.g. a -nullrhi game run of a
+// benchmark map driven with -ExecCmds. Enabled with fx.Niagara.Skeletal.Benchmark 1, written out as JSON by fx.Niagara.Skeletal.Benchmark.Dump.
+// Nothing is recorded while disabled, the scopes only check the console variable.
+namespace NiagaraSkeletalBenchmark
+{
+	enum class EPhase : uint8
+	{
+		PostSystemTick,
+		Extract,
+		Reconcile,
+		Cull,
+		Prioritize,
+		Assign,
+		Create,
+		ComputeUpdates,
+		Apply,
+		Cleanup,
+		InstancedMeshes,
+		Num
+	};
+
+	NIAGARASKELETAL_API bool IsEnabled();
+	NIAGARASKELETAL_API void Reset();
+	NIAGARASKELETAL_API FString ToJson();
+
+	// Thread safe, phase scopes may be closed on worker threads
+	NIAGARASKELETAL_API void AddPhaseTime(EPhase Phase, uint64 Cycles);
+	// Game thread only. Counters from outside a tick, e.g. components released when the pool is reset, without counting a tick
+	NIAGARASKELETAL_API void AddCounters(const FNiagaraSkeletalTickCounters& Counters);
+	// Game thread only. ContainerGrowth is how many bytes the renderer's own arrays grew by during the tick, zero once it reached its steady state
+	NIAGARASKELETAL_API void AddTick(const FNiagaraSkeletalTickCounters& Counters, int32 NumParticles, int32 NumLiveComponents, int32 PoolSize, int64 ContainerGrowth);
+
+	class FPhaseScope
+	{
+	public:
+		explicit FPhaseScope(EPhase InPhase)
+			: Phase(InPhase)
+			, StartCycles(IsEnabled() ? FPlatformTime::Cycles64() : 0)
+		{
+		}
+
+		~FPhaseScope()
+		{
+			if (StartCycles != 0)
+			{
+				AddPhaseTime(Phase, FPlatformTime::Cycles64() - StartCycles);
+			}
+		}
+
+	private:
+		EPhase Phase;
+		uint64 StartCycles;
+	};
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "NiagaraBoundsCalculator.h"
+#include "NiagaraDataSetAccessor.h"
+
+class UNiagaraSkeletalRendererProperties;
+
+// Emitter bounds for the skeletal renderer, particle positions grown by the largest referenced mesh times the largest particle scale.
+// The min / max over the data buffer goes through the readers' vectorized GetMinMax, nothing is done per particle.
+class FNiagaraSkeletalBoundsCalculator : public FNiagaraBoundsCalculator
+{
+public:
+	explicit FNiagaraSkeletalBoundsCalculator(const UNiagaraSkeletalRendererProperties* Properties);
+
+	//FNiagaraBoundsCalculator interface
+	virtual void InitAccessors(const FNiagaraDataSetCompiledData* CompiledData) override;
+	virtual FBox CalculateBounds(const FTransform& SystemTransform, const FNiagaraDataSet& DataSet, const int32 NumInstances) const override;
+	//FNiagaraBoundsCalculator interface END
+
+private:
+	FName PositionName;
+	FName ScaleName;
+	FNiagaraDataSetAccessor<FNiagaraPosition> PositionAccessor;
+	FNiagaraDataSetAccessor<FVector3f> ScaleAccessor;
+
+	// radius around the particle position that contains every referenced mesh at scale 1
+	float MaxMeshRadius = 0.0f;
+};
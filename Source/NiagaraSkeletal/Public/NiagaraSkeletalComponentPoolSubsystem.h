@@ -0,0 +1,98 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "NiagaraSkeletalComponentPoolSubsystem.generated.h"
+
+class USkeletalMesh;
+class USkeletalMeshComponent;
+
+USTRUCT()
+struct FNiagaraSkeletalParkedKey
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TObjectPtr<USkeletalMesh> SkeletalMesh;
+
+	// budgeted and plain components aren't interchangeable
+	UPROPERTY(Transient)
+	TObjectPtr<UClass> ComponentClass;
+
+	bool operator==(const FNiagaraSkeletalParkedKey& Other) const { return SkeletalMesh == Other.SkeletalMesh && ComponentClass == Other.ComponentClass; }
+	friend uint32 GetTypeHash(const FNiagaraSkeletalParkedKey& Key) { return HashCombine(GetTypeHash(Key.SkeletalMesh), GetTypeHash(Key.ComponentClass)); }
+};
+
+USTRUCT()
+struct FNiagaraSkeletalParkedComponents
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<USkeletalMeshComponent>> Components;
+
+	// real time each component was parked at, oldest first
+	TArray<double> ParkedTimes;
+};
+
+struct FNiagaraSkeletalComponentPoolStats
+{
+	// components currently parked across all meshes
+	int32 NumParked = 0;
+	// acquires served from the pool / acquires that had to create a new component
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+	// components handed back, and the ones destroyed instead because their mesh was at its cap
+	int32 NumReleased = 0;
+	int32 NumDiscarded = 0;
+	// components destroyed after sitting in the pool for longer than the idle timeout
+	int32 NumExpired = 0;
+};
+
+/**
+ * Keeps skeletal renderer components alive after their renderer is done with them, so repeated one shot effects don't pay the creation cost again.
+ * Parked components are unregistered and owned by a transient actor of the subsystem, keyed by the skeletal mesh they were set up with and their class.
+ * They are destroyed once they've been idle for fx.Niagara.Skeletal.WorldPool.IdleTimeout, when the world is cleaned up or when memory runs low.
+ */
+UCLASS(MinimalAPI)
+class UNiagaraSkeletalComponentPoolSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	static bool IsEnabled();
+
+	//USubsystem Interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//USubsystem Interface END
+
+	//FTickableGameObject Interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//FTickableGameObject Interface END
+
+	// Returns a parked component of this class set up with this mesh, renamed into NewOwner and still unregistered, or nullptr if none is parked
+	USkeletalMeshComponent* Acquire(USkeletalMesh* SkeletalMesh, UClass* ComponentClass, AActor* NewOwner);
+	// Parks the component, returns false when it can't be pooled and the caller has to destroy it
+	bool Release(USkeletalMeshComponent* Component);
+	void Empty();
+
+	const FNiagaraSkeletalComponentPoolStats& GetStats() const { return Stats; }
+	void DumpStats(FOutputDevice& Ar) const;
+
+private:
+	AActor* GetParkingOwner();
+	void DestroyExpired(double ParkedBefore);
+
+	UPROPERTY(Transient)
+	TMap<FNiagaraSkeletalParkedKey, FNiagaraSkeletalParkedComponents> ParkedComponents;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> ParkingOwner;
+
+	FNiagaraSkeletalComponentPoolStats Stats;
+	FDelegateHandle MemoryTrimHandle;
+};
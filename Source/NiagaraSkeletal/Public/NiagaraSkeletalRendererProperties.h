@@ -7,6 +7,7 @@
 #include "NiagaraCommon.h"
 #include "NiagaraDataSetAccessor.h"
 #include "NiagaraRendererProperties.h"
+#include "NiagaraSkeletalVertexAnimation.h"
 
 #include "NiagaraSkeletalRendererProperties.generated.h"
 
@@ -29,6 +30,111 @@ struct FNiagaraSkeletalReference
 	
 };
 
+UENUM()
+enum class ENiagaraSkeletalRenderMode : uint8
+{
+	/** One skeletal mesh component per particle, full animation blueprint support but limited to a few dozen particles. */
+	Components,
+	/** Animations are baked to textures in the editor and every particle is an instance of a static mesh, for crowds of thousands. */
+	VertexAnimation,
+	/** Bone transforms are baked to a texture in the editor and every particle is an instance of a static mesh skinned in the vertex shader.
+	 *  Bakes stay small with dense meshes and long animations, at the cost of a heavier vertex shader. */
+	InstancedSkinned,
+};
+
+UENUM()
+enum class ENiagaraSkeletalAnimationLODMode : uint8
+{
+	/** Evaluate the animation every frame. */
+	FullRate,
+	/** Evaluate the animation every UpdateRate frames, optionally interpolating in between. */
+	ReducedRate,
+	/** Stop ticking the component, it keeps showing its last pose. */
+	Frozen,
+};
+
+UENUM()
+enum class ENiagaraSkeletalAnimationLODMetric : uint8
+{
+	/** Tiers are picked by distance from the closest view. */
+	Distance,
+	/** Tiers are picked by the particle's approximate screen size, the mesh bounds radius over the distance to the closest view. */
+	ScreenSize,
+};
+
+UENUM()
+enum class ENiagaraSkeletalBudgetSignificance : uint8
+{
+	/** Particles closer to the nearest view are more significant. */
+	Distance,
+	/** Particles bigger on screen are more significant, the mesh bounds radius scaled by the particle over the distance to the nearest view. */
+	ScreenSize,
+	/** The particle's PriorityBinding value as is. */
+	Attribute,
+};
+
+UENUM()
+enum class ENiagaraSkeletalAnimationPlayback : uint8
+{
+	/** Components are paused and seeked to the particle's anim time whenever it changes. Exact, but every seek evaluates the pose from scratch and skips notifies and root motion. */
+	Seek,
+	/** Components play their animation themselves at a rate following the particle's anim time, and are only seeked when they drift past AnimationDriftTolerance or change animation.
+	 *  Notifies fire, root motion is extracted and the engine's update rate optimizations apply. */
+	PlayRate,
+	/** Components run a lightweight anim instance fed with the particle's animation, anim time and blend parameters. Poses are evaluated on the animation
+	 *  worker threads, crossfading when the particle switches animation and sampling blend spaces, and a component can switch animation without being set up again. */
+	AnimInstance,
+};
+
+USTRUCT()
+struct FNiagaraSkeletalAnimationLOD
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** Particles use this tier when they are closer than this (Distance), or bigger than this on screen (ScreenSize). Tiers are tested in order, particles past every tier use the last one. */
+	UPROPERTY(EditAnywhere, Category = "AnimationLOD", meta = (ClampMin = 0.0))
+	float Threshold = 0.0f;
+
+	UPROPERTY(EditAnywhere, Category = "AnimationLOD")
+	ENiagaraSkeletalAnimationLODMode Mode = ENiagaraSkeletalAnimationLODMode::FullRate;
+
+	/** Frames between animation evaluations. */
+	UPROPERTY(EditAnywhere, Category = "AnimationLOD", meta = (ClampMin = 1, ClampMax = 255, EditCondition = "Mode == ENiagaraSkeletalAnimationLODMode::ReducedRate"))
+	int32 UpdateRate = 2;
+
+	/** Interpolate the pose between evaluations, smoother but costs a blend every frame. */
+	UPROPERTY(EditAnywhere, Category = "AnimationLOD", meta = (EditCondition = "Mode == ENiagaraSkeletalAnimationLODMode::ReducedRate"))
+	bool bInterpolate = true;
+
+	/** Mesh LOD forced on the component, 0 leaves the mesh LOD to the engine. */
+	UPROPERTY(EditAnywhere, Category = "AnimationLOD", meta = (ClampMin = 0))
+	int32 ForcedMeshLOD = 0;
+};
+
+USTRUCT()
+struct FNiagaraSkeletalCustomDataBinding
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** Particle attribute written to the component's custom primitive data, vectors and colors fill consecutive indices. */
+	UPROPERTY(EditAnywhere, Category = "CustomData")
+	FNiagaraVariableAttributeBinding Binding;
+
+	/** First custom primitive data index written. */
+	UPROPERTY(EditAnywhere, Category = "CustomData", meta = (ClampMin = 0))
+	int32 CustomDataIndex = 0;
+};
+
+// Where a bound attribute lives in the particle data and where it goes in the per particle custom data
+struct FNiagaraSkeletalCustomDataLayout
+{
+	int32 FloatComponentStart = 0;
+	int32 NumFloats = 0;
+	int32 CustomDataIndex = 0;
+	// offset of this binding in the renderer's packed per particle custom data
+	int32 PackedOffset = 0;
+};
+
 UCLASS(editinlinenew,MinimalAPI, meta = (DisplayName = "Skeletal Renderer"))
 class  UNiagaraSkeletalRendererProperties : public UNiagaraRendererProperties
 {
@@ -38,13 +144,21 @@ public:
 	//UObject Interface
 	virtual void PostLoad() override;
 	virtual void PostInitProperties() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 	//UObject Interface END
 
+#if WITH_EDITOR
+	// Rebakes the vertex animation assets of every entry whose source meshes, animations or frame rate changed
+	void BakeVertexAnimations();
+#endif
+
 	static void InitCDOPropertiesAfterModuleStartup();
 
 	//~ UNiagaraRendererProperties interface
 	virtual FNiagaraRenderer* CreateEmitterRenderer(ERHIFeatureLevel::Type FeatureLevel, const FNiagaraEmitterInstance* Emitter, const FNiagaraSystemInstanceController& InController) override;
-	virtual class FNiagaraBoundsCalculator* CreateBoundsCalculator() override { return nullptr; }
+	virtual class FNiagaraBoundsCalculator* CreateBoundsCalculator() override;
 	virtual bool IsSimTargetSupported(ENiagaraSimTarget InSimTarget) const override { return InSimTarget == ENiagaraSimTarget::CPUSim; };
 	virtual void GetUsedMaterials(const FNiagaraEmitterInstance* InEmitter, TArray<UMaterialInterface*>& OutMaterials) const override;
 	virtual bool PopulateRequiredBindings(FNiagaraParameterStore& InParameterStore)  override;
@@ -61,6 +175,9 @@ public:
 	virtual bool NeedsSystemPostTick() const override { return true; }
 	virtual bool NeedsSystemCompletion() const override { return true; }
 	virtual bool NeedsMIDsForMaterials() const override { return MaterialParameters.HasAnyBindings(); }
+
+	// The mesh bound to the entry's user parameter when there is one, the entry's own mesh otherwise
+	USkeletalMesh* ResolveSkeletalMesh(const FNiagaraEmitterInstance* Emitter, int32 MeshIndex) const;
 	
 	UPROPERTY(EditAnywhere, Category = "SkeletalRendering")
 	TArray<FNiagaraSkeletalReference> SkeletalMeshes;
@@ -71,12 +188,128 @@ public:
 	UPROPERTY(EditAnywhere, Category = "SkeletalRendering")
 	int32 RendererVisibility;
 
-	UPROPERTY(EditAnywhere, Category = "SkeletalRendering", meta = (ClampMin = 1))
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering")
+	ENiagaraSkeletalRenderMode RenderMode = ENiagaraSkeletalRenderMode::Components;
+
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering", meta = (ClampMin = 1, EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
 	uint32 ComponentCountLimit = 30;
 
+	/** Frames per second sampled when baking animations to textures, lowered automatically when the bake wouldn't fit in one texture. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|VertexAnimation", meta = (ClampMin = 1.0, EditCondition = "RenderMode != ENiagaraSkeletalRenderMode::Components"))
+	float VertexAnimationFrameRate = 30.0f;
+
+	/** Material used on every slot of the baked meshes, it must sample the baked textures of the render mode (see NiagaraSkeletalVAT.ush). Leave empty to keep the skeletal mesh materials. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|VertexAnimation", meta = (EditCondition = "RenderMode != ENiagaraSkeletalRenderMode::Components"))
+	TObjectPtr<UMaterialInterface> VertexAnimationMaterial;
+
+	/** Baked assets, one per SkeletalMeshes entry. Rebaked in the editor whenever the meshes, animations, frame rate or render mode change. */
+	UPROPERTY(VisibleAnywhere, Category = "SkeletalRendering|VertexAnimation", meta = (EditCondition = "RenderMode != ENiagaraSkeletalRenderMode::Components"))
+	TArray<FNiagaraSkeletalVertexAnimationBake> VertexAnimationBakes;
+
 	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering")
 	bool bAssignComponentsOnParticleID = true;
 
+	/** Milliseconds this renderer may spend creating components per tick, particles over budget wait for later ticks. 0 uses fx.Niagara.Skeletal.ComponentCreationBudgetMS. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering", meta = (ClampMin = 0.0))
+	float ComponentCreationBudgetMS = 0.0f;
+
+	/** Number of components created when the system activates, so the pool is already filled before the first burst. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering", meta = (ClampMin = 0))
+	int32 PrewarmComponentCount = 0;
+
+	/** When the system completes, park components in the world's component pool instead of destroying them, and pick parked ones up before creating new ones. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering")
+	bool bUseWorldComponentPool = false;
+
+	/** Seconds a pooled component can stay unused before it may be trimmed from the pool. 0 keeps idle components forever. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Pooling", meta = (ClampMin = 0.0))
+	float IdleComponentTimeout = 0.0f;
+
+	/** Idle components are never trimmed below this count. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Pooling", meta = (ClampMin = 0))
+	int32 MinRetainedComponents = 0;
+
+	/** Trimming only starts once the pool holds this many components more than MinRetainedComponents, then shrinks it back to MinRetainedComponents. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Pooling", meta = (ClampMin = 0))
+	int32 IdleTrimHysteresis = 4;
+
+	/** Particles showing the same mesh and animation at nearly the same time follow one leader component's pose instead of evaluating their own. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|PoseSharing", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	bool bSharePoses = false;
+
+	/** Anim times are quantized to this many seconds when grouping particles, larger steps share more poses but make animations step. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|PoseSharing", meta = (ClampMin = 0.0, EditCondition = "bSharePoses && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	float PoseSharingTimeStep = 1.0f / 30.0f;
+
+	/** When more particles want a component than ComponentCountLimit allows, give them to the particles that are biggest on screen, weighted by PriorityBinding, instead of the first ones in the buffer. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Priority", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	bool bPrioritizeParticles = false;
+
+	/** Score bonus, as a fraction, for particles that already hold a component so components don't keep switching between particles of similar priority. Needs bAssignComponentsOnParticleID. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Priority", meta = (ClampMin = 0.0, EditCondition = "bPrioritizeParticles && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	float PriorityHysteresis = 0.25f;
+
+	/** Particles outside every local player's view frustum don't get a component. Components of particles that leave the frustums stop ticking and keep their slot for CulledComponentReleaseDelay. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Culling", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	bool bCullOffscreenParticles = false;
+
+	/** Seconds a culled particle keeps its suspended component before giving it back to the pool. Only used when assigning components on particle ID. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Culling", meta = (ClampMin = 0.0, EditCondition = "bCullOffscreenParticles && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	float CulledComponentReleaseDelay = 2.0f;
+
+	/** How components follow the particle's anim time. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Playback", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	ENiagaraSkeletalAnimationPlayback AnimationPlayback = ENiagaraSkeletalAnimationPlayback::Seek;
+
+	/** Seconds a playing component may be off from its particle's anim time before it is seeked back. Reduced rate animation LOD tiers lag by up to a few frames, so keep this above that. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Playback", meta = (ClampMin = 0.0, EditCondition = "AnimationPlayback == ENiagaraSkeletalAnimationPlayback::PlayRate && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	float AnimationDriftTolerance = 0.1f;
+
+	/** Seconds a particle's component takes to blend over when its AnimIndex changes. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|Playback", meta = (ClampMin = 0.0, EditCondition = "AnimationPlayback == ENiagaraSkeletalAnimationPlayback::AnimInstance && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	float AnimationCrossfadeDuration = 0.2f;
+
+	/** Create budget aware components and register them with the engine's animation budget allocator, so the particles share the global animation budget (a.Budget.*)
+	 *  with everything else. The allocator decides how often they tick, animation LOD tiers then only force mesh LODs. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|AnimationBudget", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	bool bUseAnimationBudgetAllocator = false;
+
+	/** What the allocator ranks the particles' components by, the least significant ones are the first to tick less. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|AnimationBudget", meta = (EditCondition = "bUseAnimationBudgetAllocator && RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	ENiagaraSkeletalBudgetSignificance BudgetSignificance = ENiagaraSkeletalBudgetSignificance::ScreenSize;
+
+	/** How particles pick their animation LOD tier. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|AnimationLOD", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	ENiagaraSkeletalAnimationLODMetric AnimationLODMetric = ENiagaraSkeletalAnimationLODMetric::Distance;
+
+	/** Animation cost tiers, nearest or biggest first. Empty evaluates every component at full rate. */
+	UPROPERTY(EditAnywhere, Category = "SkeletalRendering|AnimationLOD", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	TArray<FNiagaraSkeletalAnimationLOD> AnimationLODs;
+
+	/** Copy the particle attributes the renderer needs in parallel, one worker per attribute. The game thread still waits for the copy before the tick goes on. Only pays off for emitters with many particles. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering")
+	bool bExtractParticlesInParallel = false;
+
+	/** Components are only moved when the particle position changed by more than this many units since the last update. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering", meta = (ClampMin = 0.0))
+	float PositionUpdateTolerance = 0.01f;
+
+	/** Components are only rotated when any particle rotation axis changed by more than this many degrees since the last update. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering", meta = (ClampMin = 0.0))
+	float RotationUpdateTolerance = 0.01f;
+
+	/** Components are only rescaled when any particle scale axis changed by more than this since the last update. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering", meta = (ClampMin = 0.0))
+	float ScaleUpdateTolerance = 0.001f;
+
+	/** Animations are only re-seeked when the particle anim time changed by more than this many seconds since the last update. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering", meta = (ClampMin = 0.0))
+	float AnimTimeUpdateTolerance = 0.0001f;
+
+	/** With PlayRate playback, components only get a new play rate when the particle's rate changed by more than this. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "SkeletalRendering", meta = (ClampMin = 0.0, EditCondition = "AnimationPlayback == ENiagaraSkeletalAnimationPlayback::PlayRate"))
+	float PlayRateUpdateTolerance = 0.01f;
+
 	UPROPERTY(EditAnywhere,Category = "Bindings")
 	FNiagaraVariableAttributeBinding PositionBinding;
 
@@ -98,8 +331,23 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Bindings")
 	FNiagaraVariableAttributeBinding RendererVisibilityTagBinding;
 
+	UPROPERTY(EditAnywhere, Category = "Bindings")
+	FNiagaraVariableAttributeBinding PriorityBinding;
+
+	/** Input of blend space animations, only read with AnimInstance playback. */
+	UPROPERTY(EditAnywhere, Category = "Bindings")
+	FNiagaraVariableAttributeBinding AnimBlendParametersBinding;
+
 	UPROPERTY(EditAnywhere, Category = "Bindings")
 	FNiagaraRendererMaterialParameters MaterialParameters;
+
+	/** Per particle values written to each component's custom primitive data, only when they change. Materials read them with the PerInstanceCustomData / Custom Primitive Data nodes, no MID needed. */
+	UPROPERTY(EditAnywhere, Category = "Bindings", meta = (EditCondition = "RenderMode == ENiagaraSkeletalRenderMode::Components"))
+	TArray<FNiagaraSkeletalCustomDataBinding> CustomDataBindings;
+
+	// resolved from CustomDataBindings against the compiled data set
+	TArray<FNiagaraSkeletalCustomDataLayout> CustomDataLayouts;
+	int32 NumCustomDataFloats = 0;
 	
 	FNiagaraDataSetAccessor<FNiagaraPosition>	PositionAccessor;
 	FNiagaraDataSetAccessor<FVector3f>	RotateAccessor;
@@ -109,6 +357,8 @@ public:
 	FNiagaraDataSetAccessor<int32>		VisTagAccessor;
 	FNiagaraDataSetAccessor<int32>		AnimIndexAccessor;
 	FNiagaraDataSetAccessor<int32>		UniqueIDAccessor;
+	FNiagaraDataSetAccessor<float>		PriorityAccessor;
+	FNiagaraDataSetAccessor<FVector2f>	AnimBlendParametersAccessor;
 	
 	
 protected:
@@ -118,6 +368,8 @@ protected:
 	static FNiagaraVariable Particles_Rotate;
 	static FNiagaraVariable Particles_AnimIndex;
 	static FNiagaraVariable Particles_Enabled;
+	static FNiagaraVariable Particles_Priority;
+	static FNiagaraVariable Particles_AnimBlendParameters;
 private:
 	static TArray<TWeakObjectPtr<UNiagaraSkeletalRendererProperties>> SkeletalRendererPropertiesToDeferredInit;
 	
@@ -0,0 +1,158 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "NiagaraSkeletalSlotTable.h"
+
+// The skeletal renderer's pooling and assignment rules: which particle holds which pooled entry, which free entry a particle picks up,
+// and which unused entries go. Nothing in here knows about components or UObjects, TEntry is whatever the caller keeps per pooled
+// component, so the rules can be driven, checked and timed on their own. Whenever a component would need touching the caller is told
+// through a callback or the returned slot index.
+template<typename TEntry>
+class TNiagaraSkeletalSlotEngine
+{
+public:
+	int32 Num() const { return Entries.Num(); }
+	TEntry& operator[](int32 SlotIndex) { return Entries[SlotIndex]; }
+	const TEntry& operator[](int32 SlotIndex) const { return Entries[SlotIndex]; }
+
+	// ranged for over the entries
+	auto begin() { return Entries.begin(); }
+	auto end() { return Entries.end(); }
+	auto begin() const { return Entries.begin(); }
+	auto end() const { return Entries.end(); }
+
+	void Reserve(int32 NumSlots)
+	{
+		Entries.Reserve(NumSlots);
+		SlotTable.Reserve(NumSlots);
+	}
+
+	void Reset()
+	{
+		Entries.SetNum(0, false);
+		SlotTable.Reset();
+	}
+
+	SIZE_T GetAllocatedSize() const { return Entries.GetAllocatedSize() + SlotTable.GetAllocatedSize(); }
+
+	// Adds an entry that is neither held nor free, the caller assigns it or pushes it free straight away
+	TEntry& AddSlot(int32& OutSlotIndex)
+	{
+		OutSlotIndex = Entries.Num();
+		verify(SlotTable.AddSlot() == OutSlotIndex);
+		return Entries.AddDefaulted_GetRef();
+	}
+
+	void RemoveSlotSwap(int32 SlotIndex, bool bRebuildFreeList = true)
+	{
+		Entries.RemoveAtSwap(SlotIndex, 1, false);
+		SlotTable.RemoveSlotSwap(SlotIndex, bRebuildFreeList);
+	}
+
+	// Releases the slots of particles that died or got disabled since the last tick, OnReleased(SlotIndex) runs before each goes back on its free list
+	template<typename FuncType>
+	void Reconcile(TConstArrayView<int32> ParticleIDs, TConstArrayView<bool> Enabled, FuncType&& OnReleased)
+	{
+		if (Entries.Num() == 0)
+		{
+			return;
+		}
+
+		SlotTable.BeginReconcile();
+		for (int32 ParticleIndex = 0; ParticleIndex < ParticleIDs.Num(); ++ParticleIndex)
+		{
+			const int32 SlotIndex = SlotTable.FindSlot(ParticleIDs[ParticleIndex]);
+			if (SlotIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+			if (Enabled[ParticleIndex])
+			{
+				SlotTable.MarkAlive(SlotIndex);
+			}
+			else
+			{
+				OnReleased(SlotIndex);
+				SlotTable.Release(SlotIndex);
+			}
+		}
+
+		// whatever wasn't marked belongs to particles that died
+		SlotTable.ReleaseStale(OnReleased);
+	}
+
+	int32 FindSlot(int32 ParticleID) const { return SlotTable.FindSlot(ParticleID); }
+	int32 NumAssigned() const { return SlotTable.NumAssigned(); }
+	bool IsAssigned(int32 SlotIndex) const { return SlotTable.IsAssigned(SlotIndex); }
+
+	// A free slot for a particle that doesn't hold one, INDEX_NONE when a new entry should be added instead. One of the particle's own key
+	// is preferred. One of another key, which the caller has to reconfigure, is only handed out once the pool can't grow past MaxSlots
+	int32 AcquireFree(int32 Key, int32 MaxSlots)
+	{
+		int32 SlotIndex = SlotTable.PopFree(Key);
+		if (SlotIndex == INDEX_NONE && Entries.Num() >= MaxSlots)
+		{
+			SlotIndex = SlotTable.PopFree();
+		}
+		return SlotIndex;
+	}
+
+	// Gives back a slot from AcquireFree that ended up unused this tick, a slot the particle already held stays with it
+	void ReturnUnused(int32 SlotIndex)
+	{
+		if (!SlotTable.IsAssigned(SlotIndex))
+		{
+			SlotTable.PushFree(SlotIndex);
+		}
+	}
+
+	void PushFree(int32 SlotIndex) { SlotTable.PushFree(SlotIndex); }
+
+	// Assigns the slot unless the particle already holds it
+	void Assign(int32 SlotIndex, int32 ParticleID)
+	{
+		if (!SlotTable.IsAssigned(SlotIndex))
+		{
+			SlotTable.Assign(SlotIndex, ParticleID);
+		}
+	}
+
+	void Release(int32 SlotIndex) { SlotTable.Release(SlotIndex); }
+
+	int32 GetKey(int32 SlotIndex) const { return SlotTable.GetKey(SlotIndex); }
+	void SetKey(int32 SlotIndex, int32 Key) { SlotTable.SetKey(SlotIndex, Key); }
+
+	// Visits every entry no particle holds, the first NumInUseByIndex entries count as held too for callers handing slots out in order.
+	// Visitor(SlotIndex, Entry) returns true to have the entry removed, the last entry is swapped into its place and visited next.
+	// The free lists are relinked once after all the removals, they can't be used from the visitor
+	template<typename FuncType>
+	void TrimUnused(int32 NumInUseByIndex, FuncType&& Visitor)
+	{
+		bool bRemovedAny = false;
+		for (int32 SlotIndex = NumInUseByIndex; SlotIndex < Entries.Num(); ++SlotIndex)
+		{
+			if (SlotTable.IsAssigned(SlotIndex))
+			{
+				continue;
+			}
+
+			if (Visitor(SlotIndex, Entries[SlotIndex]))
+			{
+				RemoveSlotSwap(SlotIndex, false);
+				bRemovedAny = true;
+				--SlotIndex;
+			}
+		}
+
+		if (bRemovedAny)
+		{
+			SlotTable.RebuildFreeList();
+		}
+	}
+
+	bool CheckInvariants() const { return Entries.Num() == SlotTable.Num() && SlotTable.CheckInvariants(); }
+
+private:
+	TArray<TEntry> Entries;
+	FNiagaraSkeletalSlotTable SlotTable;
+};
@@ -0,0 +1,97 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+
+// Persistent particle ID -> component pool slot table.
+// Slots mirror the renderer's component pool one to one. Assigned slots are found through an open addressing map keyed on the
+// particle's unique ID, unassigned slots are chained on intrusive free lists, one per key. The key is whatever the component in the
+// slot is set up for (mesh and animation), so a particle can pick up a component that already matches. Nothing is rebuilt per tick,
+// so once the pool has stopped growing reconciling and assigning particles does not touch the heap.
+class FNiagaraSkeletalSlotTable
+{
+public:
+	int32 Num() const { return Slots.Num(); }
+	int32 NumAssigned() const { return NumAssignedSlots; }
+	bool IsAssigned(int32 SlotIndex) const { return Slots[SlotIndex].bAssigned; }
+	SIZE_T GetAllocatedSize() const { return Slots.GetAllocatedSize() + Buckets.GetAllocatedSize() + FreeHeads.GetAllocatedSize(); }
+
+	void Reserve(int32 NumSlots);
+	void Reset();
+
+	// Adds an unassigned slot that is not on the free list, the caller is expected to assign it straight away
+	int32 AddSlot();
+	// Mirrors TArray::RemoveAtSwap on the component pool. Relinking the free lists walks every slot, so a batch of removals
+	// passes false and calls RebuildFreeList once it is done, the free lists must not be used in between
+	void RemoveSlotSwap(int32 SlotIndex, bool bRebuildFreeList = true);
+	void RebuildFreeList();
+
+	int32 FindSlot(int32 ParticleID) const;
+	void Assign(int32 SlotIndex, int32 ParticleID);
+	// Unassigns the slot and puts it back on the free list
+	void Release(int32 SlotIndex);
+	// Returns a free slot with the given key, INDEX_NONE when there are none
+	int32 PopFree(int32 Key);
+	// Returns a free slot of any key, INDEX_NONE when there are no free slots
+	int32 PopFree();
+	// Puts an unassigned slot that isn't on a free list (new, or popped and then not used) onto the one of its key
+	void PushFree(int32 SlotIndex);
+
+	// Keys are small non negative numbers, INDEX_NONE for slots whose component isn't set up for anything yet. Only slots that aren't on a free list can change key
+	int32 GetKey(int32 SlotIndex) const { return Slots[SlotIndex].Key; }
+	void SetKey(int32 SlotIndex, int32 Key);
+
+	// Reconciliation: every slot whose particle is still alive gets marked, the rest are released by ReleaseStale
+	void BeginReconcile() { ++Generation; }
+	void MarkAlive(int32 SlotIndex) { Slots[SlotIndex].AliveGeneration = Generation; }
+
+	template<typename FuncType>
+	void ReleaseStale(FuncType&& OnReleased)
+	{
+		for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); ++SlotIndex)
+		{
+			const FSlot& Slot = Slots[SlotIndex];
+			if (Slot.bAssigned && Slot.AliveGeneration != Generation)
+			{
+				OnReleased(SlotIndex);
+				Release(SlotIndex);
+			}
+		}
+	}
+
+	// Walks the whole table, for harnesses and debug checks only
+	bool CheckInvariants() const;
+
+private:
+	struct FSlot
+	{
+		int32 ParticleID = INDEX_NONE;
+		int32 NextFree = INDEX_NONE;
+		uint32 AliveGeneration = 0;
+		int32 Key = INDEX_NONE;
+		bool bAssigned = false;
+		bool bFree = false;
+	};
+
+	struct FBucket
+	{
+		int32 ParticleID = INDEX_NONE;
+		int32 SlotIndex = INDEX_NONE;
+	};
+
+	int32 FindBucket(int32 ParticleID) const;
+	void InsertBucket(int32 ParticleID, int32 SlotIndex);
+	void RemoveBucket(int32 ParticleID);
+	void Rehash(int32 NumBuckets);
+	void LinkFree(int32 SlotIndex);
+	int32 UnlinkFreeHead(int32 ListIndex);
+
+	uint32 GetIdealBucket(int32 ParticleID) const { return MurmurFinalize32(uint32(ParticleID)) & (Buckets.Num() - 1); }
+
+	TArray<FSlot> Slots;
+	// power of two sized, kept at most half full so probe sequences stay short
+	TArray<FBucket> Buckets;
+	// head of each key's free list, indexed by key + 1 so INDEX_NONE keys get a list too
+	TArray<int32> FreeHeads;
+	int32 NumFreeSlots = 0;
+	int32 NumAssignedSlots = 0;
+	uint32 Generation = 0;
+};
@@ -0,0 +1,145 @@
+﻿// Copyright Natsu Neko, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "NiagaraSkeletalVertexAnimation.generated.h"
+
+class UAnimationAsset;
+class UMaterialInterface;
+class USkeletalMesh;
+class UStaticMesh;
+class UTexture2D;
+
+// Frames of one entry in the renderer's Animations list inside a baked animation texture
+USTRUCT()
+struct FNiagaraSkeletalVATAnimationRange
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 StartFrame = 0;
+
+	// includes the closing frame at Length, so looping playback can blend last -> first
+	UPROPERTY()
+	int32 NumFrames = 0;
+
+	UPROPERTY()
+	float Length = 0.0f;
+
+	friend FArchive& operator<<(FArchive& Ar, FNiagaraSkeletalVATAnimationRange& Range)
+	{
+		return Ar << Range.StartFrame << Range.NumFrames << Range.Length;
+	}
+};
+
+// Assets baked for one FNiagaraSkeletalReference, saved with the renderer properties so cooked builds never bake
+USTRUCT()
+struct FNiagaraSkeletalVertexAnimationBake
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = "VertexAnimation")
+	TObjectPtr<UStaticMesh> StaticMesh = nullptr;
+
+	// RGBA16F, per vertex offset from the rest pose, RowsPerFrame rows per frame
+	UPROPERTY(VisibleAnywhere, Category = "VertexAnimation")
+	TObjectPtr<UTexture2D> PositionTexture = nullptr;
+
+	// BGRA8, per vertex normal packed to 0-1, same layout as the position texture
+	UPROPERTY(VisibleAnywhere, Category = "VertexAnimation")
+	TObjectPtr<UTexture2D> NormalTexture = nullptr;
+
+	// RGBA16F, only baked for instanced skinning. One row per frame, three texels per bone holding the rows of its 3x4 skinning matrix
+	UPROPERTY(VisibleAnywhere, Category = "VertexAnimation")
+	TObjectPtr<UTexture2D> BoneTexture = nullptr;
+
+	UPROPERTY()
+	TArray<FNiagaraSkeletalVATAnimationRange> Animations;
+
+	UPROPERTY()
+	int32 RowsPerFrame = 0;
+
+	UPROPERTY()
+	int32 NumFrames = 0;
+
+	// the DDC key this was baked from, used to know when the source assets or settings changed
+	UPROPERTY()
+	FString BakeKey;
+
+	bool IsValid() const { return StaticMesh && ((PositionTexture && NormalTexture) || BoneTexture) && NumFrames > 0; }
+	bool IsSkinned() const { return BoneTexture != nullptr; }
+	UTexture2D* GetAnimationTexture() const { return IsSkinned() ? BoneTexture : PositionTexture; }
+};
+
+// Result of the CPU bake, this is what gets stored in the DDC
+struct FNiagaraSkeletalVATBakeData
+{
+	int32 NumVertices = 0;
+	int32 TextureWidth = 0;
+	int32 RowsPerFrame = 0;
+	int32 NumFrames = 0;
+	TArray<FNiagaraSkeletalVATAnimationRange> Animations;
+
+	// TextureWidth * RowsPerFrame * NumFrames texels, 4 halfs each, only when baking vertices
+	TArray<FFloat16> PositionTexels;
+	TArray<FColor> NormalTexels;
+
+	// NumBones * 3 * NumFrames texels, 4 halfs each, only when baking bones
+	int32 NumBones = 0;
+	TArray<FFloat16> BoneTexels;
+	// up to four mesh bone indices and normalized weights per vertex, only when baking bones
+	TArray<FIntVector4> BoneIndices;
+	TArray<FVector4f> BoneWeights;
+
+	// rest pose geometry of LOD0, vertex i owns texel i of every frame
+	TArray<FVector3f> RestPositions;
+	TArray<FVector3f> RestNormals;
+	TArray<FVector2f> TexCoords;
+	TArray<uint32> Indices;
+	// X: first index, Y: triangle count, Z: material index
+	TArray<FIntVector> Sections;
+
+	// bounds of every baked frame, the static mesh bounds get extended to cover them
+	FBox3f AnimatedBounds = FBox3f(ForceInit);
+
+	friend FArchive& operator<<(FArchive& Ar, FNiagaraSkeletalVATBakeData& Data);
+};
+
+namespace NiagaraSkeletalVertexAnimation
+{
+	// Material parameter names the renderer sets on the instanced mesh materials
+	extern const FName PositionTextureParamName;
+	extern const FName NormalTextureParamName;
+	extern const FName TextureSizeParamName;
+	extern const FName RowsPerFrameParamName;
+
+	extern const FName BoneTextureParamName;
+
+	// UV channel on the baked static mesh holding the vertex texel coordinate
+	static constexpr int32 VertexUVChannel = 1;
+	// UV channels holding bone indices 0-1, 2-3 then weights 0-1, 2-3 on meshes baked for instanced skinning
+	static constexpr int32 BoneIndicesUVChannel = 2;
+	static constexpr int32 BoneWeightsUVChannel = 4;
+	static constexpr int32 NumBoneInfluences = 4;
+	// Per instance custom data written for every particle: frame A, frame B, blend
+	static constexpr int32 NumCustomDataFloats = 3;
+	// Texture dimension limit shared by every RHI we care about
+	static constexpr int32 MaxTextureSize = 8192;
+
+	// Returns the absolute frames to blend between for a particle's anim time, animations loop
+	void SampleAnimation(const FNiagaraSkeletalVATAnimationRange& Range, float AnimTime, int32& OutFrameA, int32& OutFrameB, float& OutBlend);
+
+	// Texel layout used by the bake, vertices wrap over several rows when the mesh has more vertices than fit in one
+	void ComputeTextureLayout(int32 NumVertices, int32& OutTextureWidth, int32& OutRowsPerFrame);
+
+#if WITH_EDITOR
+	// Samples every frame of every animation and either skins LOD0 of the mesh on the CPU, or with bBakeBones only stores the skinning matrices
+	// and leaves the skinning to the vertex shader. Only UAnimSequenceBase entries are baked, others get an empty range
+	bool Bake(USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations, float FrameRate, bool bBakeBones, FNiagaraSkeletalVATBakeData& OutData);
+
+	// Fetches the bake from the DDC or bakes and stores it, then builds the static mesh and textures inside Outer
+	bool BakeAssets(UObject* Outer, USkeletalMesh* SkeletalMesh, TConstArrayView<TObjectPtr<UAnimationAsset>> Animations, float FrameRate, bool bBakeBones, FNiagaraSkeletalVertexAnimationBake& InOutBake);
+#endif
+}